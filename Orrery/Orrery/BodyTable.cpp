@@ -0,0 +1,240 @@
+#include "BodyTable.h"
+
+#include <math.h>
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+#include "glm/simd/common.h"
+#endif
+
+using namespace std;
+
+const double TWO_PI = 6.28318530717958647692;
+
+// Newton steps taken on Kepler's equation by the SIMD path, which cannot stop
+// early per body; enough for single precision up to e = 0.9
+const int KEPLER_ITERATIONS = 6;
+
+BodyTable::BodyTable()
+{
+	this->count = 0;
+}
+
+size_t BodyTable::Add(const OrbitalElements &orbit, double spinPeriod)
+{
+	// grow every array by a whole batch of idle bodies when the padding runs out
+	if (this->count % BODY_LANES == 0)
+	{
+		size_t size = this->count + BODY_LANES;
+		this->orbitRate.resize(size, 0.0);
+		this->epochPhase.resize(size, 0.0);
+		this->spinRate.resize(size, 0.0);
+		this->eccentricity.resize(size, 0.0f);
+		this->majorX.resize(size, 0.0f);
+		this->majorY.resize(size, 0.0f);
+		this->majorZ.resize(size, 0.0f);
+		this->minorX.resize(size, 0.0f);
+		this->minorY.resize(size, 0.0f);
+		this->minorZ.resize(size, 0.0f);
+		this->centreX.resize(size, 0.0f);
+		this->centreY.resize(size, 0.0f);
+		this->centreZ.resize(size, 0.0f);
+		this->positionX.resize(size, 0.0f);
+		this->positionY.resize(size, 0.0f);
+		this->positionZ.resize(size, 0.0f);
+		this->spinAngle.resize(size, 0.0f);
+	}
+
+	size_t body = this->count++;
+	this->spinRate[body] = (spinPeriod > 0) ? 1.0 / spinPeriod : 0.0;
+
+	// a body without a period stays at its parent's centre
+	if (orbit.period > 0)
+	{
+		Orbit evaluated(orbit);
+		glm::dvec3 major = evaluated.GetSemiMajorAxis();
+		glm::dvec3 minor = evaluated.GetSemiMinorAxis();
+		glm::dvec3 centre = -orbit.eccentricity * major;
+
+		this->orbitRate[body] = 1.0 / orbit.period;
+		this->epochPhase[body] = orbit.meanAnomalyAtEpoch / TWO_PI;
+		this->eccentricity[body] = orbit.eccentricity;
+		this->majorX[body] = major.x;
+		this->majorY[body] = major.y;
+		this->majorZ[body] = major.z;
+		this->minorX[body] = minor.x;
+		this->minorY[body] = minor.y;
+		this->minorZ[body] = minor.z;
+		this->centreX[body] = centre.x;
+		this->centreY[body] = centre.y;
+		this->centreZ[body] = centre.z;
+	}
+
+	return body;
+}
+
+void BodyTable::Clear()
+{
+	this->count = 0;
+	this->orbitRate.clear();
+	this->epochPhase.clear();
+	this->spinRate.clear();
+	this->eccentricity.clear();
+	this->majorX.clear();
+	this->majorY.clear();
+	this->majorZ.clear();
+	this->minorX.clear();
+	this->minorY.clear();
+	this->minorZ.clear();
+	this->centreX.clear();
+	this->centreY.clear();
+	this->centreZ.clear();
+	this->positionX.clear();
+	this->positionY.clear();
+	this->positionZ.clear();
+	this->spinAngle.clear();
+}
+
+size_t BodyTable::GetCount() const
+{
+	return this->count;
+}
+
+void BodyTable::Propagate(double time)
+{
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+	PropagateSSE2(time);
+#else
+	PropagateScalar(0, this->count, time);
+#endif
+}
+
+// reference implementation, in double precision throughout
+void BodyTable::PropagateScalar(size_t begin, size_t end, double time)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		double phase = time * this->orbitRate[i] + this->epochPhase[i];
+		double M = TWO_PI * (phase - floor(phase + 0.5));
+		double E = SolveKepler(M, this->eccentricity[i]);
+		float cosE = cos(E), sinE = sin(E);
+
+		this->positionX[i] = cosE * this->majorX[i] + sinE * this->minorX[i] + this->centreX[i];
+		this->positionY[i] = cosE * this->majorY[i] + sinE * this->minorY[i] + this->centreY[i];
+		this->positionZ[i] = cosE * this->majorZ[i] + sinE * this->minorZ[i] + this->centreZ[i];
+
+		double turns = time * this->spinRate[i];
+		this->spinAngle[i] = TWO_PI * (turns - floor(turns + 0.5));
+	}
+}
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+
+// sine and cosine of four angles of moderate size: reduced to a quadrant by
+// a three part Cody-Waite subtraction of pi/2 multiples, then evaluated with
+// the single precision minimax polynomials from Cephes
+static inline void SinCos4(glm_vec4 x, glm_vec4 *sine, glm_vec4 *cosine)
+{
+	glm_vec4 quadrant = glm_vec4_round(glm_vec4_mul(x, _mm_set1_ps(0.63661977236758134f)));
+	glm_vec4 r = glm_vec4_fma(quadrant, _mm_set1_ps(-1.5703125f), x);
+	r = glm_vec4_fma(quadrant, _mm_set1_ps(-4.837512969970703125e-4f), r);
+	r = glm_vec4_fma(quadrant, _mm_set1_ps(-7.54978995489188216e-8f), r);
+	glm_vec4 r2 = glm_vec4_mul(r, r);
+
+	glm_vec4 s = glm_vec4_fma(r2, _mm_set1_ps(-1.9515295891e-4f), _mm_set1_ps(8.3321608736e-3f));
+	s = glm_vec4_fma(r2, s, _mm_set1_ps(-1.6666654611e-1f));
+	s = glm_vec4_fma(glm_vec4_mul(r2, r), s, r);
+
+	glm_vec4 c = glm_vec4_fma(r2, _mm_set1_ps(2.443315711809948e-5f), _mm_set1_ps(-1.388731625493765e-3f));
+	c = glm_vec4_fma(r2, c, _mm_set1_ps(4.166664568298827e-2f));
+	c = glm_vec4_fma(glm_vec4_mul(r2, r2), c, glm_vec4_fma(r2, _mm_set1_ps(-0.5f), _mm_set1_ps(1.0f)));
+
+	// odd quadrants swap sine and cosine; quadrants 2 and 3 negate the sine,
+	// 1 and 2 the cosine
+	__m128i q = _mm_cvtps_epi32(quadrant);
+	glm_vec4 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+	glm_vec4 sineSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(2)), 30));
+	glm_vec4 cosineSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+
+	*sine = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s)), sineSign);
+	*cosine = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c)), cosineSign);
+}
+
+// 2 pi times the distance of time * rate + epoch from the nearest whole
+// number, for four bodies; done in double so it stays exact however many
+// turns have passed, before narrowing to an angle in [-pi, pi]
+static inline glm_vec4 WrappedAngle4(double time, const double *rate, const double *epoch)
+{
+	// adding and subtracting 1.5 * 2^52 rounds any double below 2^51 to an integer
+	const __m128d roundingBias = _mm_set1_pd(6755399441055744.0);
+	__m128d t = _mm_set1_pd(time);
+
+	__m128d low = _mm_add_pd(_mm_mul_pd(t, _mm_loadu_pd(rate)), _mm_loadu_pd(epoch));
+	__m128d high = _mm_add_pd(_mm_mul_pd(t, _mm_loadu_pd(rate + 2)), _mm_loadu_pd(epoch + 2));
+	low = _mm_sub_pd(low, _mm_sub_pd(_mm_add_pd(low, roundingBias), roundingBias));
+	high = _mm_sub_pd(high, _mm_sub_pd(_mm_add_pd(high, roundingBias), roundingBias));
+
+	glm_vec4 fraction = _mm_movelh_ps(_mm_cvtpd_ps(low), _mm_cvtpd_ps(high));
+	return glm_vec4_mul(fraction, _mm_set1_ps((float)TWO_PI));
+}
+
+void BodyTable::PropagateSSE2(double time)
+{
+	// padding bodies have zero rates, so spin phases start at zero for them too
+	static const double zeroPhases[BODY_LANES] = { 0, 0, 0, 0 };
+	const glm_vec4 one = _mm_set1_ps(1.0f);
+
+	for (size_t i = 0; i < this->count; i += BODY_LANES)
+	{
+		glm_vec4 M = WrappedAngle4(time, &this->orbitRate[i], &this->epochPhase[i]);
+		glm_vec4 e = _mm_loadu_ps(&this->eccentricity[i]);
+
+		// Newton's method on E - e sin E - M = 0, starting from M + e sin M
+		glm_vec4 sinE, cosE;
+		SinCos4(M, &sinE, &cosE);
+		glm_vec4 E = glm_vec4_fma(e, sinE, M);
+		for (int k = 0; k < KEPLER_ITERATIONS; k++)
+		{
+			SinCos4(E, &sinE, &cosE);
+			glm_vec4 f = glm_vec4_sub(glm_vec4_sub(E, glm_vec4_mul(e, sinE)), M);
+			glm_vec4 slope = glm_vec4_sub(one, glm_vec4_mul(e, cosE));
+			E = glm_vec4_sub(E, glm_vec4_div(f, slope));
+		}
+		SinCos4(E, &sinE, &cosE);
+
+		glm_vec4 x = glm_vec4_fma(cosE, _mm_loadu_ps(&this->majorX[i]), _mm_loadu_ps(&this->centreX[i]));
+		glm_vec4 y = glm_vec4_fma(cosE, _mm_loadu_ps(&this->majorY[i]), _mm_loadu_ps(&this->centreY[i]));
+		glm_vec4 z = glm_vec4_fma(cosE, _mm_loadu_ps(&this->majorZ[i]), _mm_loadu_ps(&this->centreZ[i]));
+		_mm_storeu_ps(&this->positionX[i], glm_vec4_fma(sinE, _mm_loadu_ps(&this->minorX[i]), x));
+		_mm_storeu_ps(&this->positionY[i], glm_vec4_fma(sinE, _mm_loadu_ps(&this->minorY[i]), y));
+		_mm_storeu_ps(&this->positionZ[i], glm_vec4_fma(sinE, _mm_loadu_ps(&this->minorZ[i]), z));
+
+		_mm_storeu_ps(&this->spinAngle[i], WrappedAngle4(time, &this->spinRate[i], zeroPhases));
+	}
+}
+
+#endif
+
+glm::vec3 BodyTable::GetPosition(size_t body) const
+{
+	return glm::vec3(this->positionX[body], this->positionY[body], this->positionZ[body]);
+}
+
+float BodyTable::GetSpinAngle(size_t body) const
+{
+	return this->spinAngle[body];
+}
+
+const float *BodyTable::GetPositionsX() const
+{
+	return this->count ? &this->positionX[0] : 0;
+}
+
+const float *BodyTable::GetPositionsY() const
+{
+	return this->count ? &this->positionY[0] : 0;
+}
+
+const float *BodyTable::GetPositionsZ() const
+{
+	return this->count ? &this->positionZ[0] : 0;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+
+#include "glm/vec3.hpp"
+#include "Orbit.h"
+
+// bodies are propagated this many at a time; the arrays are padded to a
+// multiple of it with bodies that sit still at the origin
+const size_t BODY_LANES = 4;
+
+// many bodies on Keplerian orbits stored as a structure of arrays, so a
+// whole table is propagated by one call streaming through contiguous memory,
+// four bodies per SSE2 instruction where available
+class BodyTable {
+private:
+	size_t count;
+
+	// orbits and turns per second, and the fraction of an orbit done at time 0;
+	// kept in double so the phase stays exact at large simulation times
+	std::vector<double> orbitRate;
+	std::vector<double> epochPhase;
+	std::vector<double> spinRate;
+
+	std::vector<float> eccentricity;
+
+	// the orbit as cos(E) * major + sin(E) * minor + centre for eccentric
+	// anomaly E: the semi-major and semi-minor axes as vectors, and the
+	// offset of the ellipse's centre from the parent
+	std::vector<float> majorX, majorY, majorZ;
+	std::vector<float> minorX, minorY, minorZ;
+	std::vector<float> centreX, centreY, centreZ;
+
+	// results of the last Propagate
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> spinAngle;
+
+	void PropagateScalar(size_t begin, size_t end, double time);
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+	void PropagateSSE2(double time);
+#endif
+
+public:
+	BodyTable();
+
+	// appends a body with its day length in seconds (0 if it does not spin),
+	// returning its index
+	size_t Add(const OrbitalElements &orbit, double spinPeriod);
+	void Clear();
+	size_t GetCount() const;
+
+	// evaluates every body at an absolute simulation time in seconds
+	void Propagate(double time);
+
+	// position relative to the parent and rotation angle about the spin axis
+	glm::vec3 GetPosition(size_t body) const;
+	float GetSpinAngle(size_t body) const;
+
+	// contiguous results for consumers that stream over every body
+	const float *GetPositionsX() const;
+	const float *GetPositionsY() const;
+	const float *GetPositionsZ() const;
+};
@@ -4,12 +4,16 @@
 
 #include <math.h>
 
-Camera::Camera(float fov, float aspect, float near, float far)
+Camera::Camera(float fov, float aspect, float near)
 {
 	this->theta = 0;
 	this->phi = 0;
 	this->radius = 50;
-	this->projectionMatrix = glm::perspective(fov, aspect, near, far);
+	this->fov = fov;
+	this->aspect = aspect;
+	this->near = near;
+	this->zeroToOneDepth = false;
+	UpdateProjection();
 	Update();
 }
 
@@ -52,6 +56,38 @@ void Camera::ChangeRadius(float radius)
 	Update();
 }
 
+void Camera::SetAspect(float aspect)
+{
+	this->aspect = aspect;
+	UpdateProjection();
+}
+
+void Camera::SetZeroToOneDepth(bool zeroToOne)
+{
+	this->zeroToOneDepth = zeroToOne;
+	UpdateProjection();
+}
+
+void Camera::UpdateProjection()
+{
+	// glm::perspective's field of view and aspect, with the depth row
+	// replaced: clip z is the near distance and w the distance in front of
+	// the camera, so depth falls from 1 at the near plane to 0 at infinity;
+	// from -1 to 1 clip z needs 2 near - distance for the same depths
+	float f = 1 / tan(this->fov / 2);
+	this->projectionMatrix = glm::mat4(0);
+	this->projectionMatrix[0][0] = f / this->aspect;
+	this->projectionMatrix[1][1] = f;
+	this->projectionMatrix[2][3] = -1;
+	if (this->zeroToOneDepth)
+		this->projectionMatrix[3][2] = this->near;
+	else
+	{
+		this->projectionMatrix[2][2] = 1;
+		this->projectionMatrix[3][2] = 2 * this->near;
+	}
+}
+
 void Camera::Update()
 {
 	float x = this->radius * sin(this->theta) * cos(this->phi);
@@ -70,3 +106,8 @@ glm::mat4 Camera::GetProjectionMatrix()
 {
 	return this->projectionMatrix;
 }
+
+float Camera::GetNear()
+{
+	return this->near;
+}
@@ -2,22 +2,32 @@
 
 #include "glm/mat4x4.hpp"
 
+// projects with reversed depth and no far plane: the near plane lands on
+// depth 1 and infinity on depth 0, which a floating point depth buffer
+// resolves evenly at every distance
 class Camera {
 private:
-	float fov, near, far;
+	float fov, aspect, near;
 	float theta, phi, radius;
 	
+	// clip space depth runs from 0 to 1 (glClipControl) rather than from -1
+	bool zeroToOneDepth;
+	
 	glm::mat4 viewMatrix;
 	glm::mat4 projectionMatrix;
 	
 	void Update();
+	void UpdateProjection();
 	
 public:
-	Camera(float fov, float aspect, float near, float far);
+	Camera(float fov, float aspect, float near);
 	
 	void ChangeAngles(float theta, float phi);
 	void ChangeRadius(float radius);
+	void SetAspect(float aspect);
+	void SetZeroToOneDepth(bool zeroToOne);
 	
 	glm::mat4 GetViewMatrix();
 	glm::mat4 GetProjectionMatrix();
+	float GetNear();
 };
@@ -0,0 +1,169 @@
+#include "DDSFile.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+#include "soil/image_helper.h"
+extern "C" {
+#include "soil/image_DXT.h"
+}
+
+using namespace std;
+
+const unsigned int DDS_MAGIC = 0x20534444;	// "DDS "
+
+size_t DDSLevelSize(unsigned int fourCC, int width, int height)
+{
+	// 4x4 texel blocks of 8 bytes for DXT1 and 16 bytes for DXT5
+	size_t blockBytes = (fourCC == DDS_FOURCC_DXT5) ? 16 : 8;
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+}
+
+bool CompressToDDS(const unsigned char *pixels, int width, int height, int channels, DDSImage *image)
+{
+	if (channels != 3 && channels != 4)
+	{
+		cout << "ERROR: only RGB and RGBA images can be compressed" << endl;
+		return false;
+	}
+
+	image->fourCC = (channels == 4) ? DDS_FOURCC_DXT5 : DDS_FOURCC_DXT1;
+	image->width = width;
+	image->height = height;
+	image->levels = 0;
+	image->faces = 1;
+	image->data.clear();
+	image->levelOffsets.clear();
+	image->levelSizes.clear();
+
+	vector<unsigned char> level(pixels, pixels + (size_t)width * height * channels);
+	vector<unsigned char> nextLevel;
+
+	while (true)
+	{
+		int size;
+		unsigned char *compressed = (channels == 4)
+			? convert_image_to_DXT5(&level[0], width, height, channels, &size)
+			: convert_image_to_DXT1(&level[0], width, height, channels, &size);
+		if (!compressed)
+			return false;
+
+		image->levelOffsets.push_back(image->data.size());
+		image->levelSizes.push_back(size);
+		image->data.insert(image->data.end(), compressed, compressed + size);
+		image->levels++;
+		free(compressed);
+
+		if (width == 1 && height == 1)
+			break;
+
+		// box filter the next level down from this one
+		int nextWidth = max(1, width / 2);
+		int nextHeight = max(1, height / 2);
+		nextLevel.resize((size_t)nextWidth * nextHeight * channels);
+		mipmap_image(&level[0], width, height, channels, &nextLevel[0],
+		             width > 1 ? 2 : 1, height > 1 ? 2 : 1);
+
+		level.swap(nextLevel);
+		width = nextWidth;
+		height = nextHeight;
+	}
+
+	return true;
+}
+
+bool SaveDDS(const string &filename, const DDSImage &image)
+{
+	DDS_header header;
+	memset(&header, 0, sizeof(header));
+	header.dwMagic = DDS_MAGIC;
+	header.dwSize = 124;
+	header.dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT |
+	                 DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+	header.dwHeight = image.height;
+	header.dwWidth = image.width;
+	header.dwPitchOrLinearSize = image.levelSizes[0];
+	header.dwMipMapCount = image.levels;
+	header.sPixelFormat.dwSize = 32;
+	header.sPixelFormat.dwFlags = DDPF_FOURCC;
+	header.sPixelFormat.dwFourCC = image.fourCC;
+	header.sCaps.dwCaps1 = DDSCAPS_TEXTURE | DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+	if (image.faces == 6)
+	{
+		header.sCaps.dwCaps2 = DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEX | DDSCAPS2_CUBEMAP_NEGATIVEX |
+		                       DDSCAPS2_CUBEMAP_POSITIVEY | DDSCAPS2_CUBEMAP_NEGATIVEY |
+		                       DDSCAPS2_CUBEMAP_POSITIVEZ | DDSCAPS2_CUBEMAP_NEGATIVEZ;
+	}
+
+	ofstream output(filename.c_str(), ios::binary);
+	if (!output)
+	{
+		cout << "ERROR: Could not write " << filename << endl;
+		return false;
+	}
+
+	output.write((const char *)&header, sizeof(header));
+	output.write((const char *)&image.data[0], image.data.size());
+	return output.good();
+}
+
+bool LoadDDS(const string &filename, DDSImage *image)
+{
+	ifstream input(filename.c_str(), ios::binary);
+	if (!input)
+		return false;
+
+	DDS_header header;
+	input.read((char *)&header, sizeof(header));
+	if (!input || header.dwMagic != DDS_MAGIC || header.dwSize != 124 ||
+	    !(header.sPixelFormat.dwFlags & DDPF_FOURCC) ||
+	    (header.sPixelFormat.dwFourCC != DDS_FOURCC_DXT1 && header.sPixelFormat.dwFourCC != DDS_FOURCC_DXT5))
+	{
+		cout << "ERROR: " << filename << " is not a DXT1 or DXT5 file" << endl;
+		return false;
+	}
+
+	image->fourCC = header.sPixelFormat.dwFourCC;
+	image->width = header.dwWidth;
+	image->height = header.dwHeight;
+	image->levels = (header.dwFlags & DDSD_MIPMAPCOUNT) ? max(1u, header.dwMipMapCount) : 1;
+	image->faces = (header.sCaps.dwCaps2 & DDSCAPS2_CUBEMAP) ? 6 : 1;
+	image->levelOffsets.clear();
+	image->levelSizes.clear();
+
+	size_t total = 0;
+	int width = image->width, height = image->height;
+	for (int level = 0; level < image->levels; level++)
+	{
+		image->levelOffsets.push_back(total);
+		image->levelSizes.push_back(DDSLevelSize(image->fourCC, width, height));
+		total += image->levelSizes.back();
+		width = max(1, width / 2);
+		height = max(1, height / 2);
+	}
+
+	image->data.resize(total * image->faces);
+	input.read((char *)&image->data[0], image->data.size());
+	if (!input)
+	{
+		cout << "ERROR: " << filename << " is truncated" << endl;
+		return false;
+	}
+
+	return true;
+}
+
+string DDSFileName(const string &imageFileName)
+{
+	size_t dot = imageFileName.find_last_of('.');
+	return imageFileName.substr(0, dot) + ".dds";
+}
+
+string DDSCubeMapFileName(const string &imageFileName)
+{
+	size_t dot = imageFileName.find_last_of('.');
+	return imageFileName.substr(0, dot) + "_cube.dds";
+}
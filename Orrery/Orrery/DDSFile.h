@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// four character codes of the two block compressed formats we bake to
+const unsigned int DDS_FOURCC_DXT1 = 0x31545844;	// "DXT1", BC1, opaque RGB
+const unsigned int DDS_FOURCC_DXT5 = 0x35545844;	// "DXT5", BC3, RGBA
+
+// a block compressed image with its full mip chain, as stored in a .dds file
+struct DDSImage
+{
+	unsigned int fourCC;
+	int width, height;
+	int levels;
+
+	// 1, or 6 for a cube map with its faces in the order +x, -x, +y, -y, +z, -z
+	int faces;
+
+	// every level back to back, largest first, then the same for each
+	// further face; the offsets are within a face
+	std::vector<unsigned char> data;
+	std::vector<size_t> levelOffsets;
+	std::vector<size_t> levelSizes;
+
+	DDSImage() : fourCC(0), width(0), height(0), levels(0), faces(1)
+	{}
+};
+
+// size in bytes of one level of a DXT1 or DXT5 image
+size_t DDSLevelSize(unsigned int fourCC, int width, int height);
+
+// builds the mip chain of an 8-bit RGB or RGBA image down to 1x1 and
+// compresses every level, to DXT1 for 3 channels and DXT5 for 4
+bool CompressToDDS(const unsigned char *pixels, int width, int height, int channels, DDSImage *image);
+
+bool SaveDDS(const std::string &filename, const DDSImage &image);
+
+// reads a DXT1 or DXT5 file, returning false for anything else
+bool LoadDDS(const std::string &filename, DDSImage *image);
+
+// the .dds file a source image is baked to: same path, extension replaced
+std::string DDSFileName(const std::string &imageFileName);
+
+// the .dds cube map an equirectangular image is baked to, beside it
+std::string DDSCubeMapFileName(const std::string &imageFileName);
@@ -0,0 +1,280 @@
+#include "Ephemeris.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace std;
+
+const unsigned int EPHEMERIS_MAGIC = 0x3150454f;	// "OEP1"
+
+// a circular orbit is split into this many intervals, each fitted with a
+// series of this many terms; eccentric orbits sweep through periapsis quickly
+// and need more, as many as divided by the cube of (1 - eccentricity); together
+// they keep positions within about 1e-11 of the orbit's size
+const int INTERVALS_PER_ORBIT = 4;
+const int ECCENTRICITY_POWER = 3;
+const int CHEBYSHEV_TERMS = 12;
+
+// a record holds the series for x, y, z and the spin in turns, one after another
+const int RECORD_COMPONENTS = 4;
+
+const double PI = 3.14159265358979323846;
+
+struct EphemerisHeader
+{
+	unsigned int magic;
+	int bodyCount;
+	double startTime, endTime;
+	unsigned long long sourceHash;
+
+	// a segment per body follows, then the records
+};
+
+struct EphemerisSegment
+{
+	double intervalLength;
+	int termCount;
+	int recordCount;
+
+	// from the start of the file to the body's first record
+	long long offset;
+};
+
+static void HashBytes(unsigned long long *hash, const void *data, size_t size)
+{
+	// 64-bit FNV-1a
+	const unsigned char *bytes = (const unsigned char *)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		*hash ^= bytes[i];
+		*hash *= 1099511628211ULL;
+	}
+}
+
+unsigned long long HashEphemerisSources(const vector<EphemerisSource> &sources)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+
+	// the fit's resolution is part of what a file was made from
+	int layout[] = { INTERVALS_PER_ORBIT, ECCENTRICITY_POWER, CHEBYSHEV_TERMS };
+	HashBytes(&hash, layout, sizeof(layout));
+
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		const OrbitalElements &orbit = sources[i].orbit;
+		double values[] = { orbit.semiMajorAxis, orbit.eccentricity, orbit.inclination, orbit.ascendingNode,
+		                    orbit.argumentOfPeriapsis, orbit.meanAnomalyAtEpoch, orbit.period, sources[i].spinPeriod };
+		HashBytes(&hash, values, sizeof(values));
+	}
+	return hash;
+}
+
+Ephemeris::Ephemeris()
+{
+	this->header = 0;
+	this->segments = 0;
+}
+
+bool Ephemeris::Open(const string &filename, unsigned long long sourceHash)
+{
+	Close();
+	if (!this->file.Open(filename))
+		return false;
+
+	const unsigned char *data = this->file.GetData();
+	size_t size = this->file.GetSize();
+	const EphemerisHeader *header = (const EphemerisHeader *)data;
+	if (size < sizeof(EphemerisHeader) || header->magic != EPHEMERIS_MAGIC || header->bodyCount < 0 ||
+	    header->sourceHash != sourceHash || !(header->endTime > header->startTime) ||
+	    (size - sizeof(EphemerisHeader)) / sizeof(EphemerisSegment) < (size_t)header->bodyCount)
+	{
+		this->file.Close();
+		return false;
+	}
+
+	// every record has to lie inside the file, and on a double's alignment,
+	// before any is read unchecked; a truncated or damaged file is rebuilt.
+	// The counts are compared by division so no product can overflow
+	const EphemerisSegment *segments = (const EphemerisSegment *)(data + sizeof(EphemerisHeader));
+	for (int i = 0; i < header->bodyCount; i++)
+	{
+		const EphemerisSegment &segment = segments[i];
+		bool valid = segment.termCount >= 1 && segment.recordCount >= 1 && segment.intervalLength > 0 &&
+		             segment.offset >= 0 && (size_t)segment.offset <= size &&
+		             segment.offset % alignof(double) == 0;
+		if (valid)
+		{
+			size_t doubles = (size - segment.offset) / sizeof(double);
+			valid = (size_t)segment.recordCount <= doubles / ((size_t)RECORD_COMPONENTS * segment.termCount);
+		}
+		if (!valid)
+		{
+			this->file.Close();
+			return false;
+		}
+	}
+
+	this->header = header;
+	this->segments = segments;
+	return true;
+}
+
+void Ephemeris::Close()
+{
+	this->file.Close();
+	this->header = 0;
+	this->segments = 0;
+}
+
+bool Ephemeris::IsOpen() const
+{
+	return this->header != 0;
+}
+
+int Ephemeris::GetBodyCount() const
+{
+	return this->header ? this->header->bodyCount : 0;
+}
+
+bool Ephemeris::Covers(double time) const
+{
+	return this->header && time >= this->header->startTime && time <= this->header->endTime;
+}
+
+void Ephemeris::Evaluate(int body, double time, glm::dvec3 *position, double *spin) const
+{
+	const EphemerisSegment &segment = this->segments[body];
+
+	// the interval holding the time, and where in it the time falls on [-1, 1]
+	double intervals = (time - this->header->startTime) / segment.intervalLength;
+	int record = min(max((int)floor(intervals), 0), segment.recordCount - 1);
+	double x = 2 * (intervals - record) - 1;
+
+	const double *coefficients = (const double *)(this->file.GetData() + segment.offset) +
+	                             (size_t)record * RECORD_COMPONENTS * segment.termCount;
+
+	// Clenshaw's recurrence for all four series at once
+	double results[RECORD_COMPONENTS];
+	for (int component = 0; component < RECORD_COMPONENTS; component++)
+	{
+		const double *c = coefficients + component * segment.termCount;
+		double b1 = 0, b2 = 0;
+		for (int k = segment.termCount - 1; k >= 1; k--)
+		{
+			double b0 = 2 * x * b1 - b2 + c[k];
+			b2 = b1;
+			b1 = b0;
+		}
+		results[component] = x * b1 - b2 + c[0];
+	}
+
+	*position = glm::dvec3(results[0], results[1], results[2]);
+	*spin = 2 * PI * (results[3] - floor(results[3] + 0.5));
+}
+
+// the coefficients of one interval, from the body's state at the Chebyshev
+// nodes mapped onto it
+static void FitRecord(const Orbit &orbit, double spinPeriod, double start, double length, double *record)
+{
+	double samples[RECORD_COMPONENTS][CHEBYSHEV_TERMS];
+	for (int j = 0; j < CHEBYSHEV_TERMS; j++)
+	{
+		double x = cos(PI * (j + 0.5) / CHEBYSHEV_TERMS);
+		double time = start + (x + 1) * length / 2;
+
+		glm::dvec3 position = orbit.PositionAt(time);
+		samples[0][j] = position.x;
+		samples[1][j] = position.y;
+		samples[2][j] = position.z;
+
+		// in whole turns since the epoch, which is smooth where the angle would wrap
+		samples[3][j] = (spinPeriod > 0) ? time / spinPeriod : 0;
+	}
+
+	for (int component = 0; component < RECORD_COMPONENTS; component++)
+	{
+		for (int k = 0; k < CHEBYSHEV_TERMS; k++)
+		{
+			double sum = 0;
+			for (int j = 0; j < CHEBYSHEV_TERMS; j++)
+				sum += samples[component][j] * cos(PI * k * (j + 0.5) / CHEBYSHEV_TERMS);
+			record[component * CHEBYSHEV_TERMS + k] = sum * ((k == 0) ? 1.0 : 2.0) / CHEBYSHEV_TERMS;
+		}
+	}
+}
+
+bool BuildEphemeris(const string &filename, const vector<EphemerisSource> &sources,
+                    double startTime, double endTime, WorkerPool *workers)
+{
+	if (sources.empty() || !(endTime > startTime))
+		return false;
+
+	EphemerisHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = EPHEMERIS_MAGIC;
+	header.bodyCount = sources.size();
+	header.startTime = startTime;
+	header.endTime = endTime;
+	header.sourceHash = HashEphemerisSources(sources);
+
+	// bodies that stay put still spin, which one interval fits exactly
+	vector<EphemerisSegment> segments(sources.size());
+	long long offset = sizeof(EphemerisHeader) + sources.size() * sizeof(EphemerisSegment);
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		double period = sources[i].orbit.period;
+		double intervals = ceil(INTERVALS_PER_ORBIT / pow(1 - sources[i].orbit.eccentricity, ECCENTRICITY_POWER));
+		double length = (period > 0) ? period / intervals : endTime - startTime;
+
+		segments[i].termCount = CHEBYSHEV_TERMS;
+		segments[i].recordCount = max(1, (int)ceil((endTime - startTime) / length));
+		segments[i].intervalLength = length;
+		segments[i].offset = offset;
+		offset += (long long)segments[i].recordCount * RECORD_COMPONENTS * CHEBYSHEV_TERMS * sizeof(double);
+	}
+
+	// every record is independent, so they are fitted in parallel straight
+	// into the image of the file
+	size_t recordSize = RECORD_COMPONENTS * CHEBYSHEV_TERMS;
+	vector<double> records((offset - segments[0].offset) / sizeof(double));
+	size_t firstRecord = 0;
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		Orbit orbit(sources[i].orbit);
+		double spinPeriod = sources[i].spinPeriod;
+		const EphemerisSegment &segment = segments[i];
+		double *bodyRecords = &records[firstRecord];
+
+		workers->ParallelFor(segment.recordCount, 64, [&](size_t begin, size_t end)
+		{
+			for (size_t record = begin; record < end; record++)
+				FitRecord(orbit, spinPeriod, startTime + record * segment.intervalLength, segment.intervalLength,
+				          bodyRecords + record * recordSize);
+		});
+		firstRecord += segment.recordCount * recordSize;
+	}
+
+	// written under a temporary name and renamed into place, so a reader
+	// never maps a half written file
+	string temporary = filename + ".tmp";
+	{
+		ofstream output(temporary.c_str(), ios::binary);
+		if (!output)
+		{
+			cout << "ERROR: Could not write ephemeris " << temporary << endl;
+			return false;
+		}
+		output.write((const char *)&header, sizeof(header));
+		output.write((const char *)&segments[0], segments.size() * sizeof(EphemerisSegment));
+		output.write((const char *)&records[0], records.size() * sizeof(double));
+		if (!output.good())
+			return false;
+	}
+
+	remove(filename.c_str());
+	return rename(temporary.c_str(), filename.c_str()) == 0;
+}
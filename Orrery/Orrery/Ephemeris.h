@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "glm/vec3.hpp"
+#include "MappedFile.h"
+#include "Orbit.h"
+#include "WorkerPool.h"
+
+// what an ephemeris is fitted to for one body: its orbit about its parent
+// and its day length in seconds, 0 if it does not spin
+struct EphemerisSource
+{
+	OrbitalElements orbit;
+	double spinPeriod;
+};
+
+struct EphemerisHeader;
+struct EphemerisSegment;
+
+// precomputed body states in the layout of a JPL or SPICE segment: for each
+// body, Chebyshev coefficients of its position and spin over fixed intervals
+// of time, read straight out of a mapped file; any body is evaluated at any
+// covered time by indexing its record and summing one short series
+class Ephemeris {
+private:
+	MappedFile file;
+	const EphemerisHeader *header;
+	const EphemerisSegment *segments;
+
+	Ephemeris(const Ephemeris &);
+	Ephemeris &operator=(const Ephemeris &);
+
+public:
+	Ephemeris();
+
+	// maps an ephemeris file, returning false if it is missing, malformed or
+	// was fitted to sources other than those with the given hash
+	bool Open(const std::string &filename, unsigned long long sourceHash);
+	void Close();
+	bool IsOpen() const;
+
+	int GetBodyCount() const;
+	bool Covers(double time) const;
+
+	// a body's position relative to its parent and its rotation angle about
+	// its spin axis, in [-pi, pi], at a covered time
+	void Evaluate(int body, double time, glm::dvec3 *position, double *spin) const;
+};
+
+// identifies a set of sources, so files fitted to older orbits are rebuilt
+unsigned long long HashEphemerisSources(const std::vector<EphemerisSource> &sources);
+
+// fits every body's coefficients over [startTime, endTime] in seconds, in
+// parallel on a worker pool, and writes them to an ephemeris file
+bool BuildEphemeris(const std::string &filename, const std::vector<EphemerisSource> &sources,
+                    double startTime, double endTime, WorkerPool *workers);
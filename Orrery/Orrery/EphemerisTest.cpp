@@ -0,0 +1,149 @@
+// fits an ephemeris, writes it, maps it back and checks it against the
+// Kepler orbits it was fitted to; then checks that damaged copies of the
+// file are refused rather than read out of bounds
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "Ephemeris.h"
+
+using namespace std;
+
+const double PI = 3.14159265358979323846;
+const double YEAR = 8766.15 * 3600.0;
+
+// where the first segment's record offset sits in the file: after the
+// header's magic, body count, start and end times and source hash, and the
+// segment's interval length, term count and record count
+const size_t FIRST_SEGMENT_OFFSET = 4 + 4 + 8 + 8 + 8 + 8 + 4 + 4;
+
+static int failures = 0;
+
+static string Scientific(double value)
+{
+	char text[32];
+	snprintf(text, sizeof(text), "%.3g", value);
+	return text;
+}
+
+static void Check(bool condition, const string &what)
+{
+	if (!condition)
+	{
+		cout << "FAILED: " << what << endl;
+		failures++;
+	}
+}
+
+static vector<char> ReadFile(const string &filename)
+{
+	ifstream input(filename.c_str(), ios::binary);
+	return vector<char>(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+}
+
+static void WriteFile(const string &filename, const vector<char> &bytes)
+{
+	ofstream output(filename.c_str(), ios::binary);
+	output.write(&bytes[0], bytes.size());
+}
+
+static EphemerisSource Source(double semiMajorAxis, double eccentricity, double inclination, double period, double spinPeriod)
+{
+	EphemerisSource source;
+	source.orbit.semiMajorAxis = semiMajorAxis;
+	source.orbit.eccentricity = eccentricity;
+	source.orbit.inclination = inclination;
+	source.orbit.ascendingNode = 0.3;
+	source.orbit.argumentOfPeriapsis = 1.1;
+	source.orbit.meanAnomalyAtEpoch = 2.0;
+	source.orbit.period = period;
+	source.spinPeriod = spinPeriod;
+	return source;
+}
+
+int main()
+{
+	// a body that stays put and spins, a near circular orbit like the
+	// earth's, mercury's and a fast, far more eccentric one
+	vector<EphemerisSource> sources;
+	sources.push_back(Source(0, 0, 0, 0, 600 * 3600.0));
+	sources.push_back(Source(15.0, 0.0167, 0.0, YEAR, 24 * 3600.0));
+	sources.push_back(Source(5.8, 0.2056, 0.12, 0.24 * YEAR, 58.6 * 24 * 3600.0));
+	sources.push_back(Source(2.0, 0.6, 0.4, 27.3 * 24 * 3600.0, 0));
+
+	const double span = 10 * YEAR;
+	const string filename = "EphemerisTest.eph";
+	WorkerPool workers(2);
+	Check(BuildEphemeris(filename, sources, -span, span, &workers), "the ephemeris is built");
+
+	unsigned long long sourceHash = HashEphemerisSources(sources);
+	{
+		Ephemeris ephemeris;
+		Check(ephemeris.Open(filename, sourceHash), "the ephemeris reopens");
+		Check(!ephemeris.Open(filename, sourceHash + 1), "other sources' hash is refused");
+		Check(ephemeris.Open(filename, sourceHash) && ephemeris.GetBodyCount() == (int)sources.size(), "every body is there");
+		Check(ephemeris.Covers(-span) && ephemeris.Covers(span) && !ephemeris.Covers(span * 1.01), "the span is covered");
+
+		double worstPosition = 0, worstSpin = 0;
+		for (int sample = 0; sample <= 10000 && ephemeris.IsOpen(); sample++)
+		{
+			double time = -span + 2 * span * sample / 10000.0;
+			for (size_t body = 0; body < sources.size(); body++)
+			{
+				glm::dvec3 position;
+				double spin;
+				ephemeris.Evaluate(body, time, &position, &spin);
+
+				glm::dvec3 expected = Orbit(sources[body].orbit).PositionAt(time);
+				double scale = max(sources[body].orbit.semiMajorAxis, 1.0);
+				glm::dvec3 error = position - expected;
+				worstPosition = max(worstPosition, sqrt(error.x * error.x + error.y * error.y + error.z * error.z) / scale);
+
+				double turns = (sources[body].spinPeriod > 0) ? time / sources[body].spinPeriod : 0;
+				double spinError = spin - 2 * PI * turns;
+				worstSpin = max(worstSpin, fabs(spinError - 2 * PI * floor(spinError / (2 * PI) + 0.5)));
+			}
+		}
+		Check(worstPosition < 1e-10, "positions match Kepler (worst relative error " + Scientific(worstPosition) + ")");
+		Check(worstSpin < 1e-6, "spins match (worst error " + Scientific(worstSpin) + " radians)");
+	}
+
+	vector<char> original = ReadFile(filename);
+	const string damaged = "EphemerisTest_damaged.eph";
+	Check(original.size() > FIRST_SEGMENT_OFFSET + 8, "the file holds its header");
+
+	// cut short by a byte, and by a whole record of four 12 term series
+	size_t cuts[] = { 1, 4 * 12 * sizeof(double) };
+	for (int i = 0; i < 2 && original.size() > FIRST_SEGMENT_OFFSET + 8; i++)
+	{
+		size_t cut = cuts[i];
+		WriteFile(damaged, vector<char>(original.begin(), original.end() - cut));
+		Ephemeris ephemeris;
+		Check(!ephemeris.Open(damaged, sourceHash), "a file " + to_string(cut) + " bytes short is refused");
+	}
+
+	// a record offset off a double's alignment, and one past the end
+	long long offsets[2];
+	memcpy(&offsets[0], &original[FIRST_SEGMENT_OFFSET], sizeof(long long));
+	offsets[0] += 4;
+	offsets[1] = original.size() - 8;
+	for (int i = 0; i < 2; i++)
+	{
+		vector<char> bytes = original;
+		memcpy(&bytes[FIRST_SEGMENT_OFFSET], &offsets[i], sizeof(long long));
+		WriteFile(damaged, bytes);
+		Ephemeris ephemeris;
+		Check(!ephemeris.Open(damaged, sourceHash), i == 0 ? "a misaligned record offset is refused" : "records past the end are refused");
+	}
+
+	remove(filename.c_str());
+	remove(damaged.c_str());
+
+	if (failures)
+		return 1;
+	cout << "EphemerisTest passed" << endl;
+	return 0;
+}
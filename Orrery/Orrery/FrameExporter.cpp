@@ -0,0 +1,128 @@
+#include "FrameExporter.h"
+
+#include <iostream>
+#include <string.h>
+
+// libSOIL already exports stbi_write_bmp and stbi_write_tga, so the writer
+// is compiled privately into this file, where only the PNG writer is used
+#define STB_IMAGE_WRITE_STATIC
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+#include "stb/stb_image_write.h"
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+using namespace std;
+
+// defined with the other OpenGL utility functions in boilerplate.cpp
+bool CheckGLErrors();
+
+FrameExporter::FrameExporter()
+{
+	this->width = this->height = 0;
+	this->pixelBuffers[0] = this->pixelBuffers[1] = 0;
+	this->nextPixelBuffer = 0;
+}
+
+bool FrameExporter::Initialize(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+
+	if (!this->target.Initialize(width, height))
+		return false;
+
+	// RGBA is the layout drivers read back without converting
+	glGenBuffers(2, this->pixelBuffers);
+	for (int i = 0; i < 2; i++)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, this->pixelBuffers[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, (size_t)width * height * 4, 0, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	this->image.resize((size_t)width * height * 3);
+
+	return !CheckGLErrors();
+}
+
+void FrameExporter::Destroy()
+{
+	this->target.Destroy();
+	glDeleteBuffers(2, this->pixelBuffers);
+	this->pixelBuffers[0] = this->pixelBuffers[1] = 0;
+}
+
+void FrameExporter::Bind()
+{
+	this->target.Bind();
+}
+
+bool FrameExporter::Capture(const string &fileName)
+{
+	int index = this->nextPixelBuffer;
+	this->nextPixelBuffer = 1 - index;
+
+	// the read lands in the buffer asynchronously, glReadPixels returns at once
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, this->target.GetFramebuffer());
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, this->pixelBuffers[index]);
+	glReadPixels(0, 0, this->width, this->height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	this->pendingFileNames[index] = fileName;
+
+	// by now the previous frame's read has had a whole frame to complete
+	return WritePending(1 - index);
+}
+
+bool FrameExporter::Finish()
+{
+	return WritePending(1 - this->nextPixelBuffer);
+}
+
+bool FrameExporter::WritePending(int index)
+{
+	if (this->pendingFileNames[index].empty())
+		return true;
+
+	string fileName = this->pendingFileNames[index];
+	this->pendingFileNames[index].clear();
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, this->pixelBuffers[index]);
+	const unsigned char *pixels = (const unsigned char *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+		(size_t)this->width * this->height * 4, GL_MAP_READ_BIT);
+	if (!pixels)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		cout << "ERROR: could not map the read back pixels of " << fileName << endl;
+		return false;
+	}
+
+	// OpenGL rows run bottom to top, image files top to bottom
+	for (int y = 0; y < this->height; y++)
+	{
+		const unsigned char *source = pixels + (size_t)(this->height - 1 - y) * this->width * 4;
+		unsigned char *destination = &this->image[(size_t)y * this->width * 3];
+		for (int x = 0; x < this->width; x++)
+		{
+			destination[3 * x + 0] = source[4 * x + 0];
+			destination[3 * x + 1] = source[4 * x + 1];
+			destination[3 * x + 2] = source[4 * x + 2];
+		}
+	}
+
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	if (!stbi_write_png(fileName.c_str(), this->width, this->height, 3, &this->image[0], this->width * 3))
+	{
+		cout << "ERROR: could not write " << fileName << endl;
+		return false;
+	}
+	return true;
+}
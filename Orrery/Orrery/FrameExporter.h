@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "structs.h"
+#include "RenderTarget.h"
+
+// renders frames into a render target of any size and writes them out
+// as PNG files. Each frame is read back into one of two pixel buffer objects
+// and only written once the next frame has been drawn, so the CPU never
+// stalls waiting for the frame the GPU is still working on
+class FrameExporter {
+private:
+	int width, height;
+	RenderTarget target;
+
+	GLuint pixelBuffers[2];
+	std::string pendingFileNames[2];
+	int nextPixelBuffer;
+
+	// one frame flipped to top-down rows and stripped of alpha for writing
+	std::vector<unsigned char> image;
+
+	bool WritePending(int index);
+
+public:
+	FrameExporter();
+
+	bool Initialize(int width, int height);
+	void Destroy();
+
+	// makes the framebuffer the target of subsequent drawing
+	void Bind();
+
+	// starts reading back the frame just drawn, to be saved as fileName, and
+	// writes the one before it
+	bool Capture(const std::string &fileName);
+
+	// writes the last captured frame
+	bool Finish();
+};
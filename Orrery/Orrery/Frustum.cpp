@@ -0,0 +1,118 @@
+#include "Frustum.h"
+
+#include "glm/glm.hpp"
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+#include "glm/simd/common.h"
+#endif
+
+using namespace std;
+
+void BoundingSpheres::Clear()
+{
+	this->x.clear();
+	this->y.clear();
+	this->z.clear();
+	this->radius.clear();
+}
+
+void BoundingSpheres::Add(glm::vec3 centre, float radius)
+{
+	this->x.push_back(centre.x);
+	this->y.push_back(centre.y);
+	this->z.push_back(centre.z);
+	this->radius.push_back(radius);
+}
+
+size_t BoundingSpheres::GetCount() const
+{
+	return this->radius.size();
+}
+
+Frustum::Frustum()
+{
+	for (int i = 0; i < 6; i++)
+		this->planes[i] = glm::vec4(0, 0, 0, 1);
+}
+
+void Frustum::Extract(const glm::mat4 &viewProjection)
+{
+	// each plane is the last row of the matrix plus or minus one of the
+	// others (Gribb and Hartmann); glm matrices are indexed by column
+	glm::vec4 rows[4];
+	for (int row = 0; row < 4; row++)
+		rows[row] = glm::vec4(viewProjection[0][row], viewProjection[1][row], viewProjection[2][row], viewProjection[3][row]);
+
+	this->planes[0] = rows[3] + rows[0];	// left
+	this->planes[1] = rows[3] - rows[0];	// right
+	this->planes[2] = rows[3] + rows[1];	// bottom
+	this->planes[3] = rows[3] - rows[1];	// top
+	this->planes[4] = rows[3] + rows[2];	// near, or far with reversed depth
+	this->planes[5] = rows[3] - rows[2];	// far, or near with reversed depth
+
+	// a projection with no far plane leaves one plane with no normal, which
+	// is kept as one everything is inside
+	for (int i = 0; i < 6; i++)
+	{
+		float length = glm::length(glm::vec3(this->planes[i]));
+		if (length > 0)
+			this->planes[i] /= length;
+		else
+			this->planes[i] = glm::vec4(0, 0, 0, 1);
+	}
+}
+
+bool Frustum::ContainsSphere(glm::vec3 centre, float radius) const
+{
+	for (int i = 0; i < 6; i++)
+	{
+		if (glm::dot(glm::vec3(this->planes[i]), centre) + this->planes[i].w < -radius)
+			return false;
+	}
+	return true;
+}
+
+void Frustum::CullSpheres(const BoundingSpheres &spheres, vector<unsigned char> *visible) const
+{
+	size_t count = spheres.GetCount();
+	visible->resize(count);
+	size_t i = 0;
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+	// every plane's coefficients broadcast across the lanes once, up front
+	glm_vec4 a[6], b[6], c[6], d[6];
+	for (int p = 0; p < 6; p++)
+	{
+		a[p] = _mm_set1_ps(this->planes[p].x);
+		b[p] = _mm_set1_ps(this->planes[p].y);
+		c[p] = _mm_set1_ps(this->planes[p].z);
+		d[p] = _mm_set1_ps(this->planes[p].w);
+	}
+
+	for (; i + 4 <= count; i += 4)
+	{
+		glm_vec4 x = _mm_loadu_ps(&spheres.x[i]);
+		glm_vec4 y = _mm_loadu_ps(&spheres.y[i]);
+		glm_vec4 z = _mm_loadu_ps(&spheres.z[i]);
+		glm_vec4 negativeRadius = glm_vec4_sub(_mm_setzero_ps(), _mm_loadu_ps(&spheres.radius[i]));
+
+		// a lane stays set while its sphere reaches inside every plane
+		glm_vec4 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			glm_vec4 distance = glm_vec4_fma(x, a[p], glm_vec4_fma(y, b[p], glm_vec4_fma(z, c[p], d[p])));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		(*visible)[i] = mask & 1;
+		(*visible)[i + 1] = (mask >> 1) & 1;
+		(*visible)[i + 2] = (mask >> 2) & 1;
+		(*visible)[i + 3] = (mask >> 3) & 1;
+	}
+#endif
+
+	// whatever does not fill a group of four
+	for (; i < count; i++)
+		(*visible)[i] = ContainsSphere(glm::vec3(spheres.x[i], spheres.y[i], spheres.z[i]), spheres.radius[i]) ? 1 : 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+#include "glm/mat4x4.hpp"
+
+// spheres gathered each frame for culling, as a structure of arrays
+struct BoundingSpheres
+{
+	std::vector<float> x, y, z;
+	std::vector<float> radius;
+
+	void Clear();
+	void Add(glm::vec3 centre, float radius);
+	size_t GetCount() const;
+};
+
+// the six planes bounding what a camera can see, each stored as (a, b, c, d)
+// with a unit normal pointing inwards, so a point's signed distance from a
+// plane is a x + b y + c z + d
+class Frustum {
+private:
+	glm::vec4 planes[6];
+
+public:
+	Frustum();
+
+	// takes the planes from a projection matrix times a view matrix, which
+	// gives them in world space
+	void Extract(const glm::mat4 &viewProjection);
+
+	bool ContainsSphere(glm::vec3 centre, float radius) const;
+
+	// sets visible[i] to 1 for every sphere at least partly inside and to 0
+	// for the rest, four spheres per SSE2 instruction where available
+	void CullSpheres(const BoundingSpheres &spheres, std::vector<unsigned char> *visible) const;
+};
@@ -0,0 +1,544 @@
+#include "Gravity.h"
+
+#include <algorithm>
+#include <math.h>
+
+using namespace std;
+
+// bits of each coordinate in a Morton key, which is also the deepest the tree goes
+const int MORTON_LEVELS = 21;
+
+// a node with this many bodies or fewer is not split further
+const size_t LEAF_SIZE = 8;
+
+// the tree is built top down in parallel below this depth, one task per cube
+const int PARALLEL_DEPTH = 2;
+
+// below this many bodies the whole tree is built on the calling thread
+const size_t PARALLEL_BUILD_MINIMUM = 4096;
+
+// spreads the low 21 bits of v out to every third bit
+static unsigned long long SpreadBits(unsigned int v)
+{
+	unsigned long long x = v & 0x1fffff;
+	x = (x | x << 32) & 0x1f00000000ffffULL;
+	x = (x | x << 16) & 0x1f0000ff0000ffULL;
+	x = (x | x << 8) & 0x100f00f00f00f00fULL;
+	x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+	x = (x | x << 2) & 0x1249249249249249ULL;
+	return x;
+}
+
+// which of its parent's eight cubes a key lies in at a depth from 1 to
+// MORTON_LEVELS: bit 2 is x, bit 1 is y and bit 0 is z
+static inline int Octant(unsigned long long key, int depth)
+{
+	return (key >> (3 * (MORTON_LEVELS - depth))) & 7;
+}
+
+// what building a subtree reads: the sorted bodies
+struct TreeInput
+{
+	const pair<unsigned long long, unsigned int> *order;
+	const double *x, *y, *z, *mass;
+};
+
+// the index of the first body in [begin, end) lying in the given octant or
+// a later one at this depth, all of them sharing the octants above it
+static size_t OctantStart(const TreeInput &input, size_t begin, size_t end, int depth, int octant)
+{
+	return partition_point(input.order + begin, input.order + end,
+	                       [depth, octant](const pair<unsigned long long, unsigned int> &entry)
+	                       { return Octant(entry.first, depth) < octant; }) - input.order;
+}
+
+// builds the node in nodes[slot] for the sorted bodies [begin, end), whose
+// keys agree on their first `depth` octants, and everything below it
+static void FillNode(const TreeInput &input, vector<OctreeNode> &nodes, int slot, size_t begin, size_t end,
+                     int depth, double cubeX, double cubeY, double cubeZ, double halfSize)
+{
+	OctreeNode node;
+	node.halfSize = halfSize;
+	node.firstChild = node.childCount = 0;
+	node.firstBody = begin;
+	node.bodyCount = 0;
+
+	double mass = 0, x = 0, y = 0, z = 0;
+
+	if (end - begin <= LEAF_SIZE || depth == MORTON_LEVELS)
+	{
+		node.bodyCount = end - begin;
+		for (size_t i = begin; i < end; i++)
+		{
+			mass += input.mass[i];
+			x += input.mass[i] * input.x[i];
+			y += input.mass[i] * input.y[i];
+			z += input.mass[i] * input.z[i];
+		}
+	}
+	else
+	{
+		size_t starts[9];
+		starts[0] = begin;
+		starts[8] = end;
+		for (int octant = 1; octant < 8; octant++)
+			starts[octant] = OctantStart(input, starts[octant - 1], end, depth + 1, octant);
+
+		// the children are allocated together before any of them is filled,
+		// so they sit next to each other with their own subtrees after them
+		node.firstChild = nodes.size();
+		for (int octant = 0; octant < 8; octant++)
+		{
+			if (starts[octant] < starts[octant + 1])
+				node.childCount++;
+		}
+		nodes.resize(nodes.size() + node.childCount);
+
+		double childHalf = halfSize / 2;
+		int child = node.firstChild;
+		for (int octant = 0; octant < 8; octant++)
+		{
+			if (starts[octant] == starts[octant + 1])
+				continue;
+
+			FillNode(input, nodes, child, starts[octant], starts[octant + 1], depth + 1,
+			         cubeX + ((octant & 4) ? childHalf : -childHalf),
+			         cubeY + ((octant & 2) ? childHalf : -childHalf),
+			         cubeZ + ((octant & 1) ? childHalf : -childHalf), childHalf);
+
+			const OctreeNode &filled = nodes[child];
+			mass += filled.mass;
+			x += filled.mass * filled.centreX;
+			y += filled.mass * filled.centreY;
+			z += filled.mass * filled.centreZ;
+			child++;
+		}
+	}
+
+	node.mass = mass;
+	node.centreX = (mass > 0) ? x / mass : cubeX;
+	node.centreY = (mass > 0) ? y / mass : cubeY;
+	node.centreZ = (mass > 0) ? z / mass : cubeZ;
+	nodes[slot] = node;
+}
+
+GravitySimulation::GravitySimulation(double gravitationalConstant, double softening, double openingAngle, WorkerPool *workers)
+{
+	this->gravitationalConstant = gravitationalConstant;
+	this->softening = softening;
+	this->openingAngle = openingAngle;
+	this->workers = workers;
+	this->accelerationsValid = false;
+	this->time = 0;
+}
+
+size_t GravitySimulation::AddBody(glm::dvec3 position, glm::dvec3 velocity, double mass)
+{
+	this->positionX.push_back(position.x);
+	this->positionY.push_back(position.y);
+	this->positionZ.push_back(position.z);
+	this->velocityX.push_back(velocity.x);
+	this->velocityY.push_back(velocity.y);
+	this->velocityZ.push_back(velocity.z);
+	this->accelerationX.push_back(0);
+	this->accelerationY.push_back(0);
+	this->accelerationZ.push_back(0);
+	this->mass.push_back(mass);
+	this->accelerationsValid = false;
+	return this->mass.size() - 1;
+}
+
+void GravitySimulation::Clear()
+{
+	this->positionX.clear();
+	this->positionY.clear();
+	this->positionZ.clear();
+	this->velocityX.clear();
+	this->velocityY.clear();
+	this->velocityZ.clear();
+	this->accelerationX.clear();
+	this->accelerationY.clear();
+	this->accelerationZ.clear();
+	this->mass.clear();
+	this->nodes.clear();
+	this->accelerationsValid = false;
+	this->time = 0;
+}
+
+size_t GravitySimulation::GetCount() const
+{
+	return this->mass.size();
+}
+
+double GravitySimulation::GetTime() const
+{
+	return this->time;
+}
+
+double GravitySimulation::GetGravitationalConstant() const
+{
+	return this->gravitationalConstant;
+}
+
+glm::dvec3 GravitySimulation::GetPosition(size_t body) const
+{
+	return glm::dvec3(this->positionX[body], this->positionY[body], this->positionZ[body]);
+}
+
+glm::dvec3 GravitySimulation::GetVelocity(size_t body) const
+{
+	return glm::dvec3(this->velocityX[body], this->velocityY[body], this->velocityZ[body]);
+}
+
+void GravitySimulation::BuildTree()
+{
+	size_t count = GetCount();
+	int threads = this->workers->GetThreadCount();
+	size_t grain = max<size_t>(1024, (count + threads - 1) / threads);
+
+	// a cube around every body, per chunk and then overall
+	size_t chunks = (count + grain - 1) / grain;
+	vector<glm::dvec3> chunkMin(chunks), chunkMax(chunks);
+	this->workers->ParallelFor(count, grain, [&](size_t begin, size_t end)
+	{
+		glm::dvec3 low(this->positionX[begin], this->positionY[begin], this->positionZ[begin]), high = low;
+		for (size_t i = begin + 1; i < end; i++)
+		{
+			low = glm::dvec3(min(low.x, this->positionX[i]), min(low.y, this->positionY[i]), min(low.z, this->positionZ[i]));
+			high = glm::dvec3(max(high.x, this->positionX[i]), max(high.y, this->positionY[i]), max(high.z, this->positionZ[i]));
+		}
+		chunkMin[begin / grain] = low;
+		chunkMax[begin / grain] = high;
+	});
+	glm::dvec3 low = chunkMin[0], high = chunkMax[0];
+	for (size_t i = 1; i < chunks; i++)
+	{
+		low = glm::dvec3(min(low.x, chunkMin[i].x), min(low.y, chunkMin[i].y), min(low.z, chunkMin[i].z));
+		high = glm::dvec3(max(high.x, chunkMax[i].x), max(high.y, chunkMax[i].y), max(high.z, chunkMax[i].z));
+	}
+	glm::dvec3 centre = (low + high) * 0.5;
+	double halfSize = max(max(high.x - low.x, high.y - low.y), high.z - low.z) * 0.5 * 1.001 + 1e-9;
+
+	// Morton keys, then sorted chunk by chunk and merged pairwise
+	this->order.resize(count);
+	double cellsPerUnit = (1 << MORTON_LEVELS) / (2 * halfSize);
+	this->workers->ParallelFor(count, grain, [&](size_t begin, size_t end)
+	{
+		const unsigned int maxCell = (1 << MORTON_LEVELS) - 1;
+		for (size_t i = begin; i < end; i++)
+		{
+			unsigned int cx = min(maxCell, (unsigned int)((this->positionX[i] - centre.x + halfSize) * cellsPerUnit));
+			unsigned int cy = min(maxCell, (unsigned int)((this->positionY[i] - centre.y + halfSize) * cellsPerUnit));
+			unsigned int cz = min(maxCell, (unsigned int)((this->positionZ[i] - centre.z + halfSize) * cellsPerUnit));
+			this->order[i] = make_pair(SpreadBits(cx) << 2 | SpreadBits(cy) << 1 | SpreadBits(cz), (unsigned int)i);
+		}
+		sort(this->order.begin() + begin, this->order.begin() + end);
+	});
+	for (size_t width = grain; width < count; width *= 2)
+	{
+		size_t pairs = (count + 2 * width - 1) / (2 * width);
+		this->workers->ParallelFor(pairs, 1, [&](size_t begin, size_t end)
+		{
+			for (size_t p = begin; p < end; p++)
+			{
+				size_t first = p * 2 * width;
+				size_t middle = min(first + width, count), last = min(first + 2 * width, count);
+				inplace_merge(this->order.begin() + first, this->order.begin() + middle, this->order.begin() + last);
+			}
+		});
+	}
+
+	// copies of the bodies in tree order, so leaves read contiguous memory
+	this->sortedX.resize(count);
+	this->sortedY.resize(count);
+	this->sortedZ.resize(count);
+	this->sortedMass.resize(count);
+	this->workers->ParallelFor(count, grain, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			unsigned int body = this->order[i].second;
+			this->sortedX[i] = this->positionX[body];
+			this->sortedY[i] = this->positionY[body];
+			this->sortedZ[i] = this->positionZ[body];
+			this->sortedMass[i] = this->mass[body];
+		}
+	});
+
+	TreeInput input;
+	input.order = &this->order[0];
+	input.x = &this->sortedX[0];
+	input.y = &this->sortedY[0];
+	input.z = &this->sortedZ[0];
+	input.mass = &this->sortedMass[0];
+
+	this->nodes.clear();
+	if (count < PARALLEL_BUILD_MINIMUM || threads == 1)
+	{
+		this->nodes.resize(1);
+		FillNode(input, this->nodes, 0, 0, count, 0, centre.x, centre.y, centre.z, halfSize);
+		return;
+	}
+
+	// the cubes PARALLEL_DEPTH levels down are built as independent subtrees
+	const int cubeCount = 1 << (3 * PARALLEL_DEPTH);
+	vector<size_t> cubeStarts(cubeCount + 1, count);
+	vector<int> cubes;
+	const int cubeShift = 3 * (MORTON_LEVELS - PARALLEL_DEPTH);
+	for (int cube = 0; cube < cubeCount; cube++)
+	{
+		size_t begin = (cube == 0) ? 0 : cubeStarts[cube - 1];
+		cubeStarts[cube] = lower_bound(this->order.begin() + begin, this->order.end(),
+		                               make_pair((unsigned long long)cube << cubeShift, 0u)) - this->order.begin();
+	}
+	for (int cube = 0; cube < cubeCount; cube++)
+	{
+		if (cubeStarts[cube] < cubeStarts[cube + 1])
+			cubes.push_back(cube);
+	}
+
+	vector<vector<OctreeNode> > subtrees(cubes.size());
+	this->workers->ParallelFor(cubes.size(), 1, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			int cube = cubes[i];
+			double cubeHalf = halfSize / (1 << PARALLEL_DEPTH);
+			glm::dvec3 cubeCentre = centre - glm::dvec3(halfSize - cubeHalf);
+			for (int depth = 1; depth <= PARALLEL_DEPTH; depth++)
+			{
+				int octant = (cube >> (3 * (PARALLEL_DEPTH - depth))) & 7;
+				double step = 2 * halfSize / (1 << depth);
+				cubeCentre += glm::dvec3((octant & 4) ? step : 0, (octant & 2) ? step : 0, (octant & 1) ? step : 0);
+			}
+
+			subtrees[i].resize(1);
+			FillNode(input, subtrees[i], 0, cubeStarts[cube], cubeStarts[cube + 1], PARALLEL_DEPTH,
+			         cubeCentre.x, cubeCentre.y, cubeCentre.z, cubeHalf);
+		}
+	});
+
+	// the layout is the root, the nodes one level down, then the roots of all
+	// the subtrees side by side, then the rest of each subtree in turn
+	vector<int> firstLevel;
+	for (size_t i = 0; i < cubes.size(); i++)
+	{
+		int octant = cubes[i] >> 3;
+		if (firstLevel.empty() || firstLevel.back() != octant)
+			firstLevel.push_back(octant);
+	}
+	int subtreeRoots = 1 + firstLevel.size();
+	vector<int> subtreeOffsets(cubes.size());
+	size_t total = subtreeRoots + cubes.size();
+	for (size_t i = 0; i < cubes.size(); i++)
+	{
+		subtreeOffsets[i] = total;
+		total += subtrees[i].size() - 1;
+	}
+	this->nodes.resize(total);
+
+	this->workers->ParallelFor(cubes.size(), 1, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			// local node 0 goes to its place among the roots, the rest follow
+			// in order, which keeps every node's children together
+			int shift = subtreeOffsets[i] - 1;
+			for (size_t local = 0; local < subtrees[i].size(); local++)
+			{
+				OctreeNode node = subtrees[i][local];
+				if (node.childCount)
+					node.firstChild += shift;
+				this->nodes[local ? local + shift : subtreeRoots + i] = node;
+			}
+		}
+	});
+
+	// the top levels, summarised from the subtrees beneath them
+	double firstHalf = halfSize / 2;
+	size_t cube = 0;
+	for (size_t i = 0; i < firstLevel.size(); i++)
+	{
+		int octant = firstLevel[i];
+		OctreeNode node;
+		node.halfSize = firstHalf;
+		node.firstChild = subtreeRoots + cube;
+		node.childCount = 0;
+		node.firstBody = node.bodyCount = 0;
+
+		double mass = 0, x = 0, y = 0, z = 0;
+		for (; cube < cubes.size() && (cubes[cube] >> 3) == octant; cube++)
+		{
+			const OctreeNode &child = this->nodes[subtreeRoots + cube];
+			mass += child.mass;
+			x += child.mass * child.centreX;
+			y += child.mass * child.centreY;
+			z += child.mass * child.centreZ;
+			node.childCount++;
+		}
+		node.mass = mass;
+		node.centreX = (mass > 0) ? x / mass : centre.x + ((octant & 4) ? firstHalf : -firstHalf);
+		node.centreY = (mass > 0) ? y / mass : centre.y + ((octant & 2) ? firstHalf : -firstHalf);
+		node.centreZ = (mass > 0) ? z / mass : centre.z + ((octant & 1) ? firstHalf : -firstHalf);
+		this->nodes[1 + i] = node;
+	}
+
+	OctreeNode root;
+	root.halfSize = halfSize;
+	root.firstChild = 1;
+	root.childCount = firstLevel.size();
+	root.firstBody = root.bodyCount = 0;
+	double mass = 0, x = 0, y = 0, z = 0;
+	for (int i = 1; i <= root.childCount; i++)
+	{
+		mass += this->nodes[i].mass;
+		x += this->nodes[i].mass * this->nodes[i].centreX;
+		y += this->nodes[i].mass * this->nodes[i].centreY;
+		z += this->nodes[i].mass * this->nodes[i].centreZ;
+	}
+	root.mass = mass;
+	root.centreX = (mass > 0) ? x / mass : centre.x;
+	root.centreY = (mass > 0) ? y / mass : centre.y;
+	root.centreZ = (mass > 0) ? z / mass : centre.z;
+	this->nodes[0] = root;
+}
+
+glm::dvec3 GravitySimulation::AccelerationAt(size_t sortedBody) const
+{
+	double px = this->sortedX[sortedBody], py = this->sortedY[sortedBody], pz = this->sortedZ[sortedBody];
+	double theta2 = this->openingAngle * this->openingAngle;
+	double epsilon2 = this->softening * this->softening;
+	double ax = 0, ay = 0, az = 0;
+
+	// each level pushes at most 8 children, so this cannot overflow
+	int stack[8 * (MORTON_LEVELS + 1)];
+	int top = 0;
+	stack[top++] = 0;
+
+	while (top > 0)
+	{
+		const OctreeNode &node = this->nodes[stack[--top]];
+
+		if (node.childCount == 0)
+		{
+			for (int b = node.firstBody; b < node.firstBody + node.bodyCount; b++)
+			{
+				if ((size_t)b == sortedBody)
+					continue;
+				double dx = this->sortedX[b] - px, dy = this->sortedY[b] - py, dz = this->sortedZ[b] - pz;
+				double r2 = dx * dx + dy * dy + dz * dz + epsilon2;
+				double scale = this->sortedMass[b] / (r2 * sqrt(r2));
+				ax += dx * scale;
+				ay += dy * scale;
+				az += dz * scale;
+			}
+			continue;
+		}
+
+		double dx = node.centreX - px, dy = node.centreY - py, dz = node.centreZ - pz;
+		double r2 = dx * dx + dy * dy + dz * dz;
+		if (4 * node.halfSize * node.halfSize < theta2 * r2)
+		{
+			// far enough to stand in for everything inside it
+			r2 += epsilon2;
+			double scale = node.mass / (r2 * sqrt(r2));
+			ax += dx * scale;
+			ay += dy * scale;
+			az += dz * scale;
+		}
+		else
+		{
+			for (int child = node.firstChild; child < node.firstChild + node.childCount; child++)
+				stack[top++] = child;
+		}
+	}
+
+	return this->gravitationalConstant * glm::dvec3(ax, ay, az);
+}
+
+void GravitySimulation::ComputeAccelerations()
+{
+	size_t count = GetCount();
+	if (count == 0)
+		return;
+
+	BuildTree();
+
+	// neighbouring bodies in tree order walk mostly the same nodes
+	this->workers->ParallelFor(count, 256, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			glm::dvec3 a = AccelerationAt(i);
+			unsigned int body = this->order[i].second;
+			this->accelerationX[body] = a.x;
+			this->accelerationY[body] = a.y;
+			this->accelerationZ[body] = a.z;
+		}
+	});
+
+	this->accelerationsValid = true;
+}
+
+void GravitySimulation::Step(double dt)
+{
+	if (!this->accelerationsValid)
+		ComputeAccelerations();
+
+	size_t count = GetCount();
+	double halfStep = dt / 2;
+
+	// kick by half a step, drift a whole one
+	this->workers->ParallelFor(count, 4096, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			this->velocityX[i] += this->accelerationX[i] * halfStep;
+			this->velocityY[i] += this->accelerationY[i] * halfStep;
+			this->velocityZ[i] += this->accelerationZ[i] * halfStep;
+			this->positionX[i] += this->velocityX[i] * dt;
+			this->positionY[i] += this->velocityY[i] * dt;
+			this->positionZ[i] += this->velocityZ[i] * dt;
+		}
+	});
+
+	ComputeAccelerations();
+
+	// and kick by the other half with the forces at the new positions
+	this->workers->ParallelFor(count, 4096, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			this->velocityX[i] += this->accelerationX[i] * halfStep;
+			this->velocityY[i] += this->accelerationY[i] * halfStep;
+			this->velocityZ[i] += this->accelerationZ[i] * halfStep;
+		}
+	});
+
+	this->time += dt;
+}
+
+double GravitySimulation::ComputeEnergy() const
+{
+	double kinetic = 0, potential = 0;
+	double epsilon2 = this->softening * this->softening;
+	size_t count = GetCount();
+
+	for (size_t i = 0; i < count; i++)
+	{
+		double v2 = this->velocityX[i] * this->velocityX[i] + this->velocityY[i] * this->velocityY[i] +
+		            this->velocityZ[i] * this->velocityZ[i];
+		kinetic += 0.5 * this->mass[i] * v2;
+
+		for (size_t j = i + 1; j < count; j++)
+		{
+			double dx = this->positionX[j] - this->positionX[i];
+			double dy = this->positionY[j] - this->positionY[i];
+			double dz = this->positionZ[j] - this->positionZ[i];
+			potential -= this->gravitationalConstant * this->mass[i] * this->mass[j] /
+			             sqrt(dx * dx + dy * dy + dz * dz + epsilon2);
+		}
+	}
+
+	return kinetic + potential;
+}
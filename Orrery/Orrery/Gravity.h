@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+
+#include "glm/vec3.hpp"
+#include "WorkerPool.h"
+
+// a cube of the Barnes-Hut octree, summarised by its centre of mass
+struct OctreeNode
+{
+	double centreX, centreY, centreZ;
+	double mass;
+
+	// half the cube's edge, which decides how near a body may come before
+	// the node has to be opened
+	double halfSize;
+
+	// children are stored next to each other; a leaf has none and instead
+	// covers a run of bodies in tree order
+	int firstChild, childCount;
+	int firstBody, bodyCount;
+};
+
+// bodies moving under their mutual gravity, integrated with kick-drift-kick
+// leapfrog; forces come from a Barnes-Hut octree that is rebuilt, and
+// traversed, on every thread of a worker pool each step
+class GravitySimulation {
+private:
+	double gravitationalConstant;
+	double softening;
+	double openingAngle;
+	WorkerPool *workers;
+
+	// bodies in the order they were added
+	std::vector<double> positionX, positionY, positionZ;
+	std::vector<double> velocityX, velocityY, velocityZ;
+	std::vector<double> accelerationX, accelerationY, accelerationZ;
+	std::vector<double> mass;
+	bool accelerationsValid;
+	double time;
+
+	// bodies sorted along a Morton curve, which is the order the tree's
+	// leaves cover them in, as (key, body index) pairs and copies of their state
+	std::vector<std::pair<unsigned long long, unsigned int> > order;
+	std::vector<double> sortedX, sortedY, sortedZ, sortedMass;
+	std::vector<OctreeNode> nodes;
+
+	void BuildTree();
+	void ComputeAccelerations();
+	glm::dvec3 AccelerationAt(size_t sortedBody) const;
+
+public:
+	// openingAngle is the Barnes-Hut theta: a node is treated as a point once
+	// its size over its distance drops below it
+	GravitySimulation(double gravitationalConstant, double softening, double openingAngle, WorkerPool *workers);
+
+	size_t AddBody(glm::dvec3 position, glm::dvec3 velocity, double mass);
+	void Clear();
+	size_t GetCount() const;
+
+	// moves every body forward by one step of dt seconds
+	void Step(double dt);
+
+	double GetTime() const;
+	double GetGravitationalConstant() const;
+	glm::dvec3 GetPosition(size_t body) const;
+	glm::dvec3 GetVelocity(size_t body) const;
+
+	// kinetic plus softened potential energy, summed directly in O(n^2) for
+	// checking the integrator's drift
+	double ComputeEnergy() const;
+};
@@ -0,0 +1,136 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+MappedFile::MappedFile()
+{
+	this->data = 0;
+	this->size = 0;
+#ifdef _WIN32
+	this->file = INVALID_HANDLE_VALUE;
+	this->mapping = 0;
+#else
+	this->file = -1;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const string &filename)
+{
+	Close();
+
+#ifdef _WIN32
+	this->file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+	                         FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if (this->file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(this->file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+	this->size = (size_t)fileSize.QuadPart;
+
+	this->mapping = CreateFileMappingA(this->file, 0, PAGE_READONLY, 0, 0, 0);
+	if (this->mapping)
+		this->data = (const unsigned char *)MapViewOfFile(this->mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+	this->file = open(filename.c_str(), O_RDONLY);
+	if (this->file < 0)
+		return false;
+
+	struct stat status;
+	if (fstat(this->file, &status) != 0 || status.st_size == 0)
+	{
+		Close();
+		return false;
+	}
+	this->size = (size_t)status.st_size;
+
+	void *view = mmap(0, this->size, PROT_READ, MAP_PRIVATE, this->file, 0);
+	if (view != MAP_FAILED)
+	{
+		this->data = (const unsigned char *)view;
+		// the whole file is about to be streamed through once, front to back
+		madvise(view, this->size, MADV_SEQUENTIAL);
+	}
+#endif
+
+	if (!this->data)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (this->data)
+		UnmapViewOfFile(this->data);
+	if (this->mapping)
+		CloseHandle(this->mapping);
+	if (this->file != INVALID_HANDLE_VALUE)
+		CloseHandle(this->file);
+	this->file = INVALID_HANDLE_VALUE;
+	this->mapping = 0;
+#else
+	if (this->data)
+		munmap((void *)this->data, this->size);
+	if (this->file >= 0)
+		close(this->file);
+	this->file = -1;
+#endif
+	this->data = 0;
+	this->size = 0;
+}
+
+bool MappedFile::IsOpen() const
+{
+	return this->data != 0;
+}
+
+const unsigned char *MappedFile::GetData() const
+{
+	return this->data;
+}
+
+size_t MappedFile::GetSize() const
+{
+	return this->size;
+}
+
+bool GetFileStamp(const string &filename, long long *modifiedTime, long long *size)
+{
+#ifdef _WIN32
+	struct _stat64 status;
+	if (_stat64(filename.c_str(), &status) != 0)
+		return false;
+#else
+	struct stat status;
+	if (stat(filename.c_str(), &status) != 0)
+		return false;
+#endif
+	*modifiedTime = (long long)status.st_mtime;
+	*size = (long long)status.st_size;
+	return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+
+// a read-only view of a whole file mapped into memory, so its contents are
+// paged in by the OS on first touch instead of being read into a copy
+class MappedFile {
+private:
+	const unsigned char *data;
+	size_t size;
+
+#ifdef _WIN32
+	void *file;
+	void *mapping;
+#else
+	int file;
+#endif
+
+	// a mapping is owned by exactly one object
+	MappedFile(const MappedFile &);
+	MappedFile &operator=(const MappedFile &);
+
+public:
+	MappedFile();
+	~MappedFile();
+
+	// maps the file, returning false if it does not exist or is empty
+	bool Open(const std::string &filename);
+	void Close();
+
+	bool IsOpen() const;
+	const unsigned char *GetData() const;
+	size_t GetSize() const;
+};
+
+// the modification time and size of a file, which together tell whether
+// something made from it is out of date
+bool GetFileStamp(const std::string &filename, long long *modifiedTime, long long *size);
@@ -0,0 +1,84 @@
+#include "Occlusion.h"
+
+// defined with the other OpenGL utility functions in boilerplate.cpp
+bool CheckGLErrors();
+
+OcclusionQueries::OcclusionQueries()
+{
+}
+
+bool OcclusionQueries::Initialize(int count)
+{
+	Destroy();
+	if (count <= 0)
+		return true;
+
+	this->queries.resize(count);
+	this->pending.assign(count, 0);
+	this->hidden.assign(count, 0);
+	glGenQueries(count, &this->queries[0]);
+	return !CheckGLErrors();
+}
+
+void OcclusionQueries::Destroy()
+{
+	if (!this->queries.empty())
+		glDeleteQueries(this->queries.size(), &this->queries[0]);
+	this->queries.clear();
+	this->pending.clear();
+	this->hidden.clear();
+}
+
+int OcclusionQueries::GetCount() const
+{
+	return this->queries.size();
+}
+
+void OcclusionQueries::Collect()
+{
+	for (size_t i = 0; i < this->queries.size(); i++)
+	{
+		if (!this->pending[i])
+			continue;
+
+		// asking whether a result is there never stalls, reading one that
+		// is not would
+		GLuint available = GL_FALSE;
+		COUNT_GL(glGetQueryObjectuiv(this->queries[i], GL_QUERY_RESULT_AVAILABLE, &available));
+		if (!available)
+			continue;
+
+		GLuint samplesPassed = GL_FALSE;
+		COUNT_GL(glGetQueryObjectuiv(this->queries[i], GL_QUERY_RESULT, &samplesPassed));
+		this->hidden[i] = samplesPassed ? 0 : 1;
+		this->pending[i] = 0;
+	}
+}
+
+void OcclusionQueries::Forget(int slot)
+{
+	this->pending[slot] = 0;
+	this->hidden[slot] = 0;
+}
+
+bool OcclusionQueries::IsHidden(int slot) const
+{
+	return this->hidden[slot] != 0;
+}
+
+GLuint OcclusionQueries::GetPendingQuery(int slot) const
+{
+	return this->pending[slot] ? this->queries[slot] : 0;
+}
+
+void OcclusionQueries::Begin(int slot)
+{
+	// a query issued again before its last result was read just replaces it
+	COUNT_GL(glBeginQuery(GL_ANY_SAMPLES_PASSED, this->queries[slot]));
+	this->pending[slot] = 1;
+}
+
+void OcclusionQueries::End()
+{
+	COUNT_GL(glEndQuery(GL_ANY_SAMPLES_PASSED));
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+#include "structs.h"
+
+// one GL_ANY_SAMPLES_PASSED query per slot, issued while drawing a cheap
+// stand-in for something after the rest of the frame, and read back a frame
+// later without waiting, so that what was hidden behind nearer bodies need
+// not be drawn
+class OcclusionQueries {
+private:
+	std::vector<GLuint> queries;
+
+	// 1 while a slot's query has been issued and its result not yet read
+	std::vector<unsigned char> pending;
+
+	// 1 when the latest result read said no sample of the stand-in passed
+	std::vector<unsigned char> hidden;
+
+	OcclusionQueries(const OcclusionQueries &);
+	OcclusionQueries &operator=(const OcclusionQueries &);
+
+public:
+	OcclusionQueries();
+
+	bool Initialize(int count);
+	void Destroy();
+
+	int GetCount() const;
+
+	// reads the results of whichever queries have finished, leaving the
+	// others pending
+	void Collect();
+
+	// drops what is known about a slot, which is then treated as visible
+	void Forget(int slot);
+
+	bool IsHidden(int slot) const;
+
+	// the query whose result a slot is still waiting for, to draw under
+	// conditional rendering, or 0 if there is none
+	GLuint GetPendingQuery(int slot) const;
+
+	// counts whether any sample of what is drawn in between passes the depth test
+	void Begin(int slot);
+	void End();
+};
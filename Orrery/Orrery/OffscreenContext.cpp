@@ -0,0 +1,143 @@
+#include "OffscreenContext.h"
+
+#include <iostream>
+#include <string.h>
+
+#ifndef _WIN32
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+using namespace std;
+
+OffscreenContext::OffscreenContext()
+{
+#ifdef _WIN32
+	this->window = 0;
+#else
+	this->display = EGL_NO_DISPLAY;
+	this->context = EGL_NO_CONTEXT;
+#endif
+}
+
+OffscreenContext::~OffscreenContext()
+{
+	Destroy();
+}
+
+#ifdef _WIN32
+
+bool OffscreenContext::Create()
+{
+	if (!glfwInit())
+	{
+		cout << "ERROR: GLFW failed to initilize" << endl;
+		return false;
+	}
+
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	this->window = glfwCreateWindow(16, 16, "Orrery", 0, 0);
+	if (!this->window)
+	{
+		cout << "ERROR: could not create a hidden GLFW window" << endl;
+		glfwTerminate();
+		return false;
+	}
+
+	glfwMakeContextCurrent(this->window);
+	return true;
+}
+
+void OffscreenContext::Destroy()
+{
+	if (this->window)
+	{
+		glfwDestroyWindow(this->window);
+		glfwTerminate();
+		this->window = 0;
+	}
+}
+
+#else
+
+bool OffscreenContext::Create()
+{
+	// the surfaceless platform needs neither X nor a GPU; fall back to the
+	// default display on EGL implementations that lack it
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	EGLDisplay display = EGL_NO_DISPLAY;
+	if (getPlatformDisplay)
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, 0);
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+	{
+		cout << "ERROR: could not initialize an EGL display" << endl;
+		return false;
+	}
+	this->display = display;
+
+	// nothing is ever drawn to an EGL surface, frames go to an FBO instead
+	const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+	if (!extensions || !strstr(extensions, "EGL_KHR_surfaceless_context"))
+	{
+		cout << "ERROR: EGL " << major << "." << minor << " does not support surfaceless contexts" << endl;
+		Destroy();
+		return false;
+	}
+
+	// no surface type, as the default asks for window support
+	EGLint configAttributes[] = {
+		EGL_SURFACE_TYPE, 0,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint configCount = 0;
+	if (!eglBindAPI(EGL_OPENGL_API) ||
+	    !eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0)
+	{
+		cout << "ERROR: EGL has no desktop OpenGL configuration" << endl;
+		Destroy();
+		return false;
+	}
+
+	EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 1,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	this->context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+	if (this->context == EGL_NO_CONTEXT ||
+	    !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, (EGLContext)this->context))
+	{
+		cout << "ERROR: could not create an OpenGL 4.1 core context through EGL" << endl;
+		Destroy();
+		return false;
+	}
+
+	return true;
+}
+
+void OffscreenContext::Destroy()
+{
+	if (this->display != EGL_NO_DISPLAY)
+	{
+		eglMakeCurrent((EGLDisplay)this->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (this->context != EGL_NO_CONTEXT)
+			eglDestroyContext((EGLDisplay)this->display, (EGLContext)this->context);
+		eglTerminate((EGLDisplay)this->display);
+	}
+	this->display = EGL_NO_DISPLAY;
+	this->context = EGL_NO_CONTEXT;
+}
+
+#endif
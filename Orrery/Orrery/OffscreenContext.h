@@ -0,0 +1,27 @@
+#pragma once
+
+#include "structs.h"
+
+// an OpenGL 4.1 core profile context without a window, for rendering into
+// framebuffer objects on machines with no display. On Linux this is an EGL
+// context on Mesa's surfaceless platform (or the default display), which
+// also runs on CPU-only boxes through llvmpipe; elsewhere it falls back to
+// a hidden GLFW window
+class OffscreenContext {
+private:
+#ifdef _WIN32
+	GLFWwindow *window;
+#else
+	// EGLDisplay and EGLContext, kept opaque so EGL stays out of this header
+	void *display;
+	void *context;
+#endif
+
+public:
+	OffscreenContext();
+	~OffscreenContext();
+
+	// creates the context and makes it current on the calling thread
+	bool Create();
+	void Destroy();
+};
@@ -0,0 +1,94 @@
+#include "Orbit.h"
+
+#include <math.h>
+
+const double PI = 3.14159265358979323846;
+
+// the ecliptic frame has Z towards the north pole, the scene has Y up with
+// orbits running anticlockwise seen from above
+static glm::dvec3 EclipticToScene(double x, double y, double z)
+{
+	return glm::dvec3(x, z, -y);
+}
+
+double SolveKepler(double meanAnomaly, double eccentricity)
+{
+	// wrap to [-pi, pi] so accuracy does not depend on how many orbits have passed
+	double M = fmod(meanAnomaly, 2 * PI);
+	if (M > PI)
+		M -= 2 * PI;
+	else if (M < -PI)
+		M += 2 * PI;
+
+	// Newton's method converges in a handful of steps from this start for
+	// any e < 1; the cap keeps evaluation bounded
+	double E = (eccentricity < 0.8) ? M : (M < 0 ? -PI : PI);
+	for (int i = 0; i < 16; i++)
+	{
+		double step = (E - eccentricity * sin(E) - M) / (1 - eccentricity * cos(E));
+		E -= step;
+		if (fabs(step) < 1e-12)
+			break;
+	}
+	return E;
+}
+
+Orbit::Orbit()
+{
+	this->periapsisDirection = glm::dvec3(1, 0, 0);
+	this->semiMinorDirection = glm::dvec3(0, 0, -1);
+	this->semiMinorAxis = 0;
+}
+
+Orbit::Orbit(const OrbitalElements &elements)
+{
+	this->elements = elements;
+
+	double cosNode = cos(elements.ascendingNode), sinNode = sin(elements.ascendingNode);
+	double cosPeri = cos(elements.argumentOfPeriapsis), sinPeri = sin(elements.argumentOfPeriapsis);
+	double cosInc = cos(elements.inclination), sinInc = sin(elements.inclination);
+
+	// perifocal basis rotated by the node, inclination and argument of periapsis
+	this->periapsisDirection = EclipticToScene(
+		cosNode * cosPeri - sinNode * sinPeri * cosInc,
+		sinNode * cosPeri + cosNode * sinPeri * cosInc,
+		sinPeri * sinInc);
+	this->semiMinorDirection = EclipticToScene(
+		-cosNode * sinPeri - sinNode * cosPeri * cosInc,
+		-sinNode * sinPeri + cosNode * cosPeri * cosInc,
+		cosPeri * sinInc);
+
+	double e = elements.eccentricity;
+	this->semiMinorAxis = elements.semiMajorAxis * sqrt(1 - e * e);
+}
+
+const OrbitalElements &Orbit::GetElements() const
+{
+	return this->elements;
+}
+
+glm::dvec3 Orbit::GetSemiMajorAxis() const
+{
+	return this->elements.semiMajorAxis * this->periapsisDirection;
+}
+
+glm::dvec3 Orbit::GetSemiMinorAxis() const
+{
+	return this->semiMinorAxis * this->semiMinorDirection;
+}
+
+glm::dvec3 Orbit::PositionAt(double time) const
+{
+	if (this->elements.period <= 0)
+		return glm::dvec3(0, 0, 0);
+
+	// only the fraction of the current orbit matters, which keeps the mean
+	// anomaly small however large the time gets
+	double orbits = fmod(time, this->elements.period) / this->elements.period;
+	double M = this->elements.meanAnomalyAtEpoch + 2 * PI * orbits;
+	double E = SolveKepler(M, this->elements.eccentricity);
+
+	double x = this->elements.semiMajorAxis * (cos(E) - this->elements.eccentricity);
+	double y = this->semiMinorAxis * sin(E);
+	return x * this->periapsisDirection + y * this->semiMinorDirection;
+}
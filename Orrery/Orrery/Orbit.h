@@ -0,0 +1,56 @@
+#pragma once
+
+#include "glm/vec3.hpp"
+
+// classical Keplerian elements of an orbit around the parent body. Angles
+// are in radians, relative to the scene's XZ plane (the ecliptic) and its
+// X axis; distances are in scene units and the period in seconds
+struct OrbitalElements
+{
+	double semiMajorAxis;
+	double eccentricity;
+	double inclination;
+	double ascendingNode;
+	double argumentOfPeriapsis;
+
+	// where the body is at simulation time 0
+	double meanAnomalyAtEpoch;
+
+	// 0 for a body that stays at its parent's centre
+	double period;
+
+	OrbitalElements() : semiMajorAxis(0), eccentricity(0), inclination(0), ascendingNode(0),
+	                    argumentOfPeriapsis(0), meanAnomalyAtEpoch(0), period(0)
+	{}
+};
+
+// solves Kepler's equation M = E - e sin E for the eccentric anomaly E of an
+// elliptical orbit (e < 1)
+double SolveKepler(double meanAnomaly, double eccentricity);
+
+// evaluates the position of a body on its orbit at any simulation time, in
+// constant time and without replaying earlier frames
+class Orbit {
+private:
+	OrbitalElements elements;
+
+	// unit vectors towards periapsis and 90 degrees ahead of it in the
+	// orbital plane, in scene coordinates
+	glm::dvec3 periapsisDirection;
+	glm::dvec3 semiMinorDirection;
+	double semiMinorAxis;
+
+public:
+	Orbit();
+	Orbit(const OrbitalElements &elements);
+
+	const OrbitalElements &GetElements() const;
+
+	// the ellipse's semi-major axis pointing at periapsis and its semi-minor
+	// axis pointing the way the body moves from there, in scene coordinates
+	glm::dvec3 GetSemiMajorAxis() const;
+	glm::dvec3 GetSemiMinorAxis() const;
+
+	// position relative to the parent body at an absolute simulation time
+	glm::dvec3 PositionAt(double time) const;
+};
@@ -0,0 +1,125 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+
+// defined with the other OpenGL utility functions in boilerplate.cpp
+bool CheckGLErrors();
+
+// orders draws by pass, then by the cost of the state they change: programs
+// first, vertex arrays next and textures last
+static bool DrawItemLess(const DrawItem &a, const DrawItem &b)
+{
+	if (a.pass != b.pass)
+		return a.pass < b.pass;
+	if (a.program != b.program)
+		return a.program < b.program;
+	if (a.vertexArray != b.vertexArray)
+		return a.vertexArray < b.vertexArray;
+	for (int unit = 0; unit < MAX_DRAW_TEXTURES; unit++)
+	{
+		if (a.textures[unit] != b.textures[unit])
+			return a.textures[unit] < b.textures[unit];
+	}
+	return false;
+}
+
+RenderQueue::RenderQueue()
+{
+	this->stateChanges = 0;
+	Invalidate();
+}
+
+void RenderQueue::Submit(const DrawItem &item)
+{
+	this->items.push_back(item);
+}
+
+void RenderQueue::Flush()
+{
+	// stable so that equal keys keep their submission order
+	std::stable_sort(this->items.begin(), this->items.end(), DrawItemLess);
+
+	for (size_t i = 0; i < this->items.size(); i++)
+	{
+		const DrawItem &item = this->items[i];
+
+		if (item.program != this->boundProgram)
+		{
+			COUNT_GL(glUseProgram(item.program));
+			this->boundProgram = item.program;
+			this->stateChanges++;
+		}
+
+		if (item.vertexArray != this->boundVertexArray)
+		{
+			COUNT_GL(glBindVertexArray(item.vertexArray));
+			this->boundVertexArray = item.vertexArray;
+			this->stateChanges++;
+		}
+
+		for (int unit = 0; unit < MAX_DRAW_TEXTURES; unit++)
+		{
+			if (!item.textures[unit])
+				continue;
+			if (item.textures[unit] == this->boundTextures[unit] &&
+			    item.textureTargets[unit] == this->boundTextureTargets[unit])
+				continue;
+
+			GLenum textureUnit = GL_TEXTURE0 + (GLenum)unit;
+			if (this->activeTextureUnit != textureUnit)
+			{
+				COUNT_GL(glActiveTexture(textureUnit));
+				this->activeTextureUnit = textureUnit;
+			}
+			COUNT_GL(glBindTexture(item.textureTargets[unit], item.textures[unit]));
+			this->boundTextureTargets[unit] = item.textureTargets[unit];
+			this->boundTextures[unit] = item.textures[unit];
+			this->stateChanges++;
+		}
+
+		if (item.baseInstanceLocation >= 0)
+			COUNT_GL(glUniform1i(item.baseInstanceLocation, item.baseInstance));
+		if (item.sphereEdgesLocation >= 0)
+			COUNT_GL(glUniform2i(item.sphereEdgesLocation, item.sphereEdges[0], item.sphereEdges[1]));
+
+		// the GPU waits for the query's result, which has long been issued,
+		// rather than the CPU
+		if (item.conditionQuery)
+			COUNT_GL(glBeginConditionalRender(item.conditionQuery, GL_QUERY_WAIT));
+
+		if (item.indexType == GL_NONE)
+			COUNT_GL(glDrawArraysInstanced(item.mode, 0, item.count, item.instanceCount));
+		else
+			COUNT_GL(glDrawElementsInstanced(item.mode, item.count, item.indexType, 0, item.instanceCount));
+
+		if (item.conditionQuery)
+			COUNT_GL(glEndConditionalRender());
+	}
+
+	this->items.clear();
+
+	// polling for errors stalls the pipeline, so only debug builds (make
+	// debug, or the Debug configurations) do it per frame
+#ifdef ORRERY_GL_DEBUG
+	CheckGLErrors();
+#endif
+}
+
+void RenderQueue::Invalidate()
+{
+	this->boundProgram = 0;
+	this->boundVertexArray = 0;
+	for (int unit = 0; unit < MAX_DRAW_TEXTURES; unit++)
+	{
+		this->boundTextureTargets[unit] = GL_NONE;
+		this->boundTextures[unit] = 0;
+	}
+	this->activeTextureUnit = GL_NONE;
+}
+
+unsigned int RenderQueue::TakeStateChanges()
+{
+	unsigned int changes = this->stateChanges;
+	this->stateChanges = 0;
+	return changes;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+#include "structs.h"
+
+// texture units a single draw may bind
+const int MAX_DRAW_TEXTURES = 2;
+
+// one draw call together with the OpenGL state it needs
+struct DrawItem
+{
+	// draws with a lower pass are issued first regardless of state, so that
+	// anything relying on draw order (e.g. a background drawn last) can say so
+	int pass;
+
+	GLuint program;
+	GLuint vertexArray;
+
+	// texture bound to each unit, a name of 0 leaves that unit untouched
+	GLenum textureTargets[MAX_DRAW_TEXTURES];
+	GLuint textures[MAX_DRAW_TEXTURES];
+
+	// a GL_NONE index type draws arrays instead of elements
+	GLenum mode;
+	GLsizei count;
+	GLenum indexType;
+	GLsizei instanceCount;
+
+	// first record of this draw in the instance buffer, skipped if location is -1
+	GLint baseInstanceLocation;
+	GLint baseInstance;
+
+	// latitude and longitude edges of a sphere the vertex shader makes up
+	// from gl_VertexID, skipped if location is -1
+	GLint sphereEdgesLocation;
+	GLint sphereEdges[2];
+
+	// an occlusion query whose samples must have passed for this draw to be
+	// carried out, decided on the GPU; 0 always draws
+	GLuint conditionQuery;
+
+	DrawItem() : pass(0), program(0), vertexArray(0), mode(GL_TRIANGLES), count(0),
+		indexType(GL_NONE), instanceCount(1), baseInstanceLocation(-1), baseInstance(0),
+		sphereEdgesLocation(-1), conditionQuery(0)
+	{
+		sphereEdges[0] = sphereEdges[1] = 0;
+		for (int unit = 0; unit < MAX_DRAW_TEXTURES; unit++)
+		{
+			textureTargets[unit] = GL_TEXTURE_2D;
+			textures[unit] = 0;
+		}
+	}
+};
+
+// collects a frame's draws, orders them to minimise state changes and issues
+// them while skipping any bind that would not change the current state
+class RenderQueue {
+private:
+	std::vector<DrawItem> items;
+
+	// state as last set by Flush, 0 when unknown
+	GLuint boundProgram;
+	GLuint boundVertexArray;
+	GLenum boundTextureTargets[MAX_DRAW_TEXTURES];
+	GLuint boundTextures[MAX_DRAW_TEXTURES];
+	GLenum activeTextureUnit;
+
+	unsigned int stateChanges;
+
+public:
+	RenderQueue();
+
+	void Submit(const DrawItem &item);
+
+	// sorts and draws everything submitted since the last flush
+	void Flush();
+
+	// forgets the tracked state, to be called after binding outside the queue
+	void Invalidate();
+
+	// binds issued by Flush since the last call, then resets the count
+	unsigned int TakeStateChanges();
+};
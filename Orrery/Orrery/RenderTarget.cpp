@@ -0,0 +1,83 @@
+#include "RenderTarget.h"
+
+#include <iostream>
+
+using namespace std;
+
+// defined with the other OpenGL utility functions in boilerplate.cpp
+bool CheckGLErrors();
+
+RenderTarget::RenderTarget()
+{
+	this->width = this->height = 0;
+	this->framebuffer = 0;
+	this->colorBuffer = this->depthBuffer = 0;
+}
+
+bool RenderTarget::Initialize(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+
+	glGenRenderbuffers(1, &this->colorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, this->colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glGenRenderbuffers(1, &this->depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, this->depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32F, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &this->framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, this->colorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, this->depthBuffer);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		cout << "ERROR: render target framebuffer is incomplete (" << hex << status << dec << ")" << endl;
+		return false;
+	}
+
+	return !CheckGLErrors();
+}
+
+void RenderTarget::Destroy()
+{
+	glDeleteFramebuffers(1, &this->framebuffer);
+	glDeleteRenderbuffers(1, &this->colorBuffer);
+	glDeleteRenderbuffers(1, &this->depthBuffer);
+	this->framebuffer = this->colorBuffer = this->depthBuffer = 0;
+}
+
+bool RenderTarget::Resize(int width, int height)
+{
+	if (width == this->width && height == this->height)
+		return true;
+
+	Destroy();
+	if (!Initialize(width, height))
+		return false;
+	Bind();
+	return true;
+}
+
+void RenderTarget::Bind()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+	glViewport(0, 0, this->width, this->height);
+}
+
+GLuint RenderTarget::GetFramebuffer() const
+{
+	return this->framebuffer;
+}
+
+void RenderTarget::BlitToWindow(int windowWidth, int windowHeight)
+{
+	COUNT_GL(glBindFramebuffer(GL_READ_FRAMEBUFFER, this->framebuffer));
+	COUNT_GL(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0));
+	COUNT_GL(glBlitFramebuffer(0, 0, this->width, this->height, 0, 0, windowWidth, windowHeight,
+	                           GL_COLOR_BUFFER_BIT, GL_LINEAR));
+	COUNT_GL(glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer));
+}
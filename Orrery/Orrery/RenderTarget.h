@@ -0,0 +1,31 @@
+#pragma once
+
+#include "structs.h"
+
+// a framebuffer object frames are drawn into, with a 32-bit floating point
+// depth buffer since the camera's reversed depth needs one to stay precise;
+// the window's own framebuffer only offers fixed point depth
+class RenderTarget {
+private:
+	int width, height;
+	GLuint framebuffer;
+	GLuint colorBuffer, depthBuffer;
+
+public:
+	RenderTarget();
+
+	bool Initialize(int width, int height);
+	void Destroy();
+
+	// recreates the buffers at a new size and binds them, doing nothing if
+	// the size has not changed
+	bool Resize(int width, int height);
+
+	// makes the framebuffer the target of subsequent drawing
+	void Bind();
+
+	GLuint GetFramebuffer() const;
+
+	// copies the colour into the window's back buffer, stretched to its size
+	void BlitToWindow(int windowWidth, int windowHeight);
+};
@@ -0,0 +1,365 @@
+#include "Scene.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+using namespace std;
+
+const unsigned int SCENE_MAGIC = 0x3443534f;	// "OSC4"
+
+// the bodies follow the header, then the texture names' offsets and the
+// string table they point into
+struct SceneHeader
+{
+	unsigned int magic;
+	int bodyCount;
+	int textureCount;
+	int stringsSize;
+
+	// the text the scene was compiled from
+	long long modifiedTime;
+	long long sourceSize;
+
+	// string offsets of the background's images, -1 for none
+	int starImage;
+	int skyImage;
+
+	// the body whose orbit sets the particle disc's gravity and the layer
+	// its particles wear, -1 for no disc
+	int particleBody;
+	int particleLayer;
+};
+
+Scene::Scene()
+{
+	this->header = 0;
+	this->bodies = 0;
+	this->textureNames = 0;
+	this->strings = 0;
+}
+
+bool Scene::Open(const string &filename, const string &sourceFilename)
+{
+	Close();
+	if (!this->file.Open(filename))
+		return false;
+
+	const unsigned char *data = this->file.GetData();
+	size_t size = this->file.GetSize();
+	const SceneHeader *header = (const SceneHeader *)data;
+	bool valid = size >= sizeof(SceneHeader) && header->magic == SCENE_MAGIC && header->bodyCount >= 0 &&
+	             header->textureCount >= 0 && header->stringsSize > 0 &&
+	             size == sizeof(SceneHeader) + header->bodyCount * sizeof(SceneBody) +
+	                     header->textureCount * sizeof(int) + header->stringsSize;
+
+	// a scene shipped without its text is used as it is
+	long long modifiedTime, sourceSize;
+	if (valid && GetFileStamp(sourceFilename, &modifiedTime, &sourceSize))
+		valid = modifiedTime == header->modifiedTime && sourceSize == header->sourceSize;
+
+	if (!valid)
+	{
+		this->file.Close();
+		return false;
+	}
+
+	const SceneBody *bodies = (const SceneBody *)(data + sizeof(SceneHeader));
+	const int *textureNames = (const int *)(bodies + header->bodyCount);
+	const char *strings = (const char *)(textureNames + header->textureCount);
+
+	// every index has to stay inside the file before any is followed unchecked
+	valid = strings[header->stringsSize - 1] == 0 && header->starImage >= -1 && header->starImage < header->stringsSize &&
+	        header->skyImage >= -1 && header->skyImage < header->stringsSize &&
+	        header->particleBody >= -1 && header->particleBody < header->bodyCount &&
+	        header->particleLayer >= -1 && header->particleLayer < header->textureCount &&
+	        (header->particleBody < 0) == (header->particleLayer < 0);
+	for (int i = 0; valid && i < header->bodyCount; i++)
+	{
+		const SceneBody &body = bodies[i];
+		valid = body.parent >= -1 && body.parent < i && body.textureLayer >= 0 && body.textureLayer < header->textureCount &&
+		        body.name >= 0 && body.name < header->stringsSize;
+	}
+	for (int i = 0; valid && i < header->textureCount; i++)
+		valid = textureNames[i] >= 0 && textureNames[i] < header->stringsSize;
+
+	if (!valid)
+	{
+		this->file.Close();
+		return false;
+	}
+
+	this->header = header;
+	this->bodies = bodies;
+	this->textureNames = textureNames;
+	this->strings = strings;
+	return true;
+}
+
+void Scene::Close()
+{
+	this->file.Close();
+	this->header = 0;
+	this->bodies = 0;
+	this->textureNames = 0;
+	this->strings = 0;
+}
+
+bool Scene::IsOpen() const
+{
+	return this->header != 0;
+}
+
+int Scene::GetBodyCount() const
+{
+	return this->header ? this->header->bodyCount : 0;
+}
+
+const SceneBody &Scene::GetBody(int body) const
+{
+	return this->bodies[body];
+}
+
+const char *Scene::GetBodyName(int body) const
+{
+	return this->strings + this->bodies[body].name;
+}
+
+int Scene::GetTextureCount() const
+{
+	return this->header ? this->header->textureCount : 0;
+}
+
+const char *Scene::GetTextureName(int layer) const
+{
+	return this->strings + this->textureNames[layer];
+}
+
+const char *Scene::GetStarImage() const
+{
+	return (this->header->starImage >= 0) ? this->strings + this->header->starImage : 0;
+}
+
+const char *Scene::GetSkyImage() const
+{
+	return (this->header->skyImage >= 0) ? this->strings + this->header->skyImage : 0;
+}
+
+int Scene::GetParticleBody() const
+{
+	return this->header->particleBody;
+}
+
+int Scene::GetParticleLayer() const
+{
+	return this->header->particleLayer;
+}
+
+// appends a name to the string table, returning its offset
+static int AddString(string *strings, const string &value)
+{
+	int offset = strings->size();
+	strings->append(value);
+	strings->push_back(0);
+	return offset;
+}
+
+// finds a texture's layer, adding it to the array if it is new
+static int AddTexture(vector<string> *textures, vector<int> *textureNames, string *strings, const string &texture)
+{
+	vector<string>::iterator found = find(textures->begin(), textures->end(), texture);
+	if (found != textures->end())
+		return found - textures->begin();
+
+	textures->push_back(texture);
+	textureNames->push_back(AddString(strings, texture));
+	return textures->size() - 1;
+}
+
+bool CompileScene(const string &sourceFilename, const string &filename)
+{
+	ifstream input(sourceFilename.c_str());
+	if (!input)
+	{
+		cout << "ERROR: Could not open scene " << sourceFilename << endl;
+		return false;
+	}
+
+	SceneHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = SCENE_MAGIC;
+	header.starImage = -1;
+	header.skyImage = -1;
+	header.particleBody = -1;
+	header.particleLayer = -1;
+
+	vector<SceneBody> bodies;
+	vector<string> bodyNames;
+	vector<string> textures;
+	vector<int> textureNames;
+	string strings;
+
+	// the particles line may name a body before it is described
+	string particleBody;
+	int particleLine = 0;
+
+	string line;
+	for (int lineNumber = 1; getline(input, line); lineNumber++)
+	{
+		line = line.substr(0, line.find('#'));
+		istringstream tokens(line);
+		string keyword;
+		if (!(tokens >> keyword))
+			continue;
+
+		bool valid = true;
+		if (keyword == "stars" || keyword == "sky")
+		{
+			string image;
+			valid = (bool)(tokens >> image);
+			if (valid)
+				(keyword == "stars" ? header.starImage : header.skyImage) = AddString(&strings, image);
+		}
+		else if (keyword == "particles")
+		{
+			string texture;
+			valid = (bool)(tokens >> particleBody >> texture);
+			if (valid)
+			{
+				header.particleLayer = AddTexture(&textures, &textureNames, &strings, texture);
+				particleLine = lineNumber;
+			}
+		}
+		else if (keyword == "body")
+		{
+			string name;
+			valid = (tokens >> name) && find(bodyNames.begin(), bodyNames.end(), name) == bodyNames.end();
+			if (valid)
+			{
+				SceneBody body;
+				memset(&body, 0, sizeof(body));
+				body.parent = -1;
+				body.textureLayer = -1;
+				body.name = AddString(&strings, name);
+				bodies.push_back(body);
+				bodyNames.push_back(name);
+			}
+		}
+		else if (bodies.empty())
+			valid = false;
+		else
+		{
+			// everything else describes the body most recently started
+			SceneBody &body = bodies.back();
+			if (keyword == "parent")
+			{
+				// parents come first, which is the order the scene graph needs
+				string parent;
+				valid = (bool)(tokens >> parent);
+				vector<string>::iterator found = find(bodyNames.begin(), bodyNames.end() - 1, parent);
+				valid = valid && found != bodyNames.end() - 1;
+				body.parent = found - bodyNames.begin();
+			}
+			else if (keyword == "texture")
+			{
+				string texture;
+				valid = (bool)(tokens >> texture);
+				if (valid)
+					body.textureLayer = AddTexture(&textures, &textureNames, &strings, texture);
+			}
+			else if (keyword == "emissive")
+				body.flags |= SCENE_BODY_EMISSIVE;
+			else if (keyword == "radius")
+				valid = (tokens >> body.radius) && body.radius > 0;
+			else if (keyword == "day")
+				valid = (tokens >> body.dayLength) && body.dayLength >= 0;
+			else if (keyword == "tilt")
+				valid = (bool)(tokens >> body.axialTilt);
+			else if (keyword == "clearance")
+				valid = (bool)(tokens >> body.orbitClearance);
+			else if (keyword == "orbit")
+			{
+				valid = (tokens >> body.semiMajorAxis >> body.eccentricity >> body.inclination >> body.ascendingNode
+				                >> body.argumentOfPeriapsis >> body.meanAnomalyAtEpoch >> body.orbitalPeriod) &&
+				        body.semiMajorAxis > 0 && body.eccentricity >= 0 && body.eccentricity < 1 && body.orbitalPeriod > 0;
+			}
+			else
+				valid = false;
+		}
+
+		if (!valid)
+		{
+			cout << "ERROR: " << sourceFilename << ":" << lineNumber << ": could not read \"" << line << "\"" << endl;
+			return false;
+		}
+	}
+
+	if ((header.starImage < 0) == (header.skyImage < 0))
+	{
+		cout << "ERROR: " << sourceFilename << ": the scene needs either a stars or a sky line" << endl;
+		return false;
+	}
+	for (size_t i = 0; i < bodies.size(); i++)
+	{
+		if (bodies[i].textureLayer < 0 || !(bodies[i].radius > 0))
+		{
+			cout << "ERROR: " << sourceFilename << ": body " << bodyNames[i] << " needs a texture and a radius" << endl;
+			return false;
+		}
+	}
+
+	if (particleLine)
+	{
+		// the disc circles the body's parent under the gravity its orbit implies
+		vector<string>::iterator found = find(bodyNames.begin(), bodyNames.end(), particleBody);
+		header.particleBody = found - bodyNames.begin();
+		if (found == bodyNames.end() || bodies[header.particleBody].parent < 0 || !(bodies[header.particleBody].orbitalPeriod > 0))
+		{
+			cout << "ERROR: " << sourceFilename << ":" << particleLine << ": particles need a body with a parent and an orbit" << endl;
+			return false;
+		}
+	}
+
+	header.bodyCount = bodies.size();
+	header.textureCount = textureNames.size();
+	strings.push_back(0);
+	header.stringsSize = strings.size();
+	if (!GetFileStamp(sourceFilename, &header.modifiedTime, &header.sourceSize))
+		return false;
+
+	// written under a temporary name and renamed into place, so a reader
+	// never maps a half written scene
+	string temporary = filename + ".tmp";
+	{
+		ofstream output(temporary.c_str(), ios::binary);
+		if (!output)
+		{
+			cout << "ERROR: Could not write scene " << temporary << endl;
+			return false;
+		}
+		output.write((const char *)&header, sizeof(header));
+		if (!bodies.empty())
+			output.write((const char *)&bodies[0], bodies.size() * sizeof(SceneBody));
+		if (!textureNames.empty())
+			output.write((const char *)&textureNames[0], textureNames.size() * sizeof(int));
+		output.write(strings.data(), strings.size());
+		if (!output.good())
+			return false;
+	}
+
+	remove(filename.c_str());
+	return rename(temporary.c_str(), filename.c_str()) == 0;
+}
+
+bool LoadScene(const string &sourceFilename, Scene *scene)
+{
+	string filename = sourceFilename + ".bin";
+	if (scene->Open(filename, sourceFilename))
+		return true;
+
+	return CompileScene(sourceFilename, filename) && scene->Open(filename, sourceFilename);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string>
+
+#include "MappedFile.h"
+
+// the body glows with its own light instead of being lit by a star
+const int SCENE_BODY_EMISSIVE = 1;
+
+// one body as compiled from a scene's text, in the text's units: kilometres,
+// degrees and hours
+struct SceneBody
+{
+	double semiMajorAxis;
+	double eccentricity;
+	double inclination;
+	double ascendingNode;
+	double argumentOfPeriapsis;
+	double meanAnomalyAtEpoch;
+
+	// 0 for a body that stays at its parent's centre
+	double orbitalPeriod;
+
+	float radius;
+	float dayLength;
+	float axialTilt;
+
+	// parent radii added to the orbit's size, so exaggerated bodies do not overlap
+	float orbitClearance;
+
+	// index of an earlier body, or -1 at the root
+	int parent;
+	int textureLayer;
+	int flags;
+
+	// offset of the body's name in the string table
+	int name;
+};
+
+struct SceneHeader;
+
+// a compiled scene: bodies in parent first order with the texture array
+// layers they use, mapped straight from its file and read in place
+class Scene {
+private:
+	MappedFile file;
+	const SceneHeader *header;
+	const SceneBody *bodies;
+	const int *textureNames;
+	const char *strings;
+
+	Scene(const Scene &);
+	Scene &operator=(const Scene &);
+
+public:
+	Scene();
+
+	// maps a compiled scene, returning false if it is missing, malformed or
+	// older than the text it was compiled from
+	bool Open(const std::string &filename, const std::string &sourceFilename);
+	void Close();
+	bool IsOpen() const;
+
+	int GetBodyCount() const;
+	const SceneBody &GetBody(int body) const;
+	const char *GetBodyName(int body) const;
+
+	// image files of the body texture array, one per layer
+	int GetTextureCount() const;
+	const char *GetTextureName(int layer) const;
+
+	// the background, one of: a sky map the stars are found in and drawn as
+	// points (see StarCatalog.h), or one baked to a cube map and drawn as
+	// it is; 0 for the one the scene does not use
+	const char *GetStarImage() const;
+	const char *GetSkyImage() const;
+
+	// the --gravity disc circles this body's parent, under the gravity that
+	// holds the body in its orbit, and its particles wear this layer; -1 for
+	// a scene without a disc
+	int GetParticleBody() const;
+	int GetParticleLayer() const;
+};
+
+// compiles a scene's text into its binary form, reporting the first error
+bool CompileScene(const std::string &sourceFilename, const std::string &filename);
+
+// opens the compiled form of a scene text, kept beside it with a .bin
+// suffix and compiled again whenever the text changes
+bool LoadScene(const std::string &sourceFilename, Scene *scene);
@@ -0,0 +1,96 @@
+#include "SceneGraph.h"
+
+#include "glm/gtc/matrix_transform.hpp"
+
+using namespace std;
+
+SceneGraph::SceneGraph()
+{
+	this->updatedCount = 0;
+}
+
+int SceneGraph::AddNode(int parent, float scale, float axialTilt)
+{
+	int node = this->parents.size();
+	if (parent >= node)
+		return -1;
+
+	glm::mat4 shape = glm::scale(glm::mat4(), glm::vec3(scale));
+	shape = glm::rotate(shape, axialTilt, glm::vec3(0, 0, 1));
+
+	this->parents.push_back(parent);
+	this->positions.push_back(glm::vec3(0));
+	this->spins.push_back(0);
+	this->shapes.push_back(shape);
+	this->frames.push_back(glm::mat4());
+	this->worldMatrices.push_back(shape);
+	this->flags.push_back(MOVED | SPUN);
+	return node;
+}
+
+size_t SceneGraph::GetCount() const
+{
+	return this->parents.size();
+}
+
+void SceneGraph::SetLocal(int node, glm::vec3 position, float spin)
+{
+	if (position != this->positions[node])
+	{
+		this->positions[node] = position;
+		this->flags[node] |= MOVED;
+	}
+	if (spin != this->spins[node])
+	{
+		this->spins[node] = spin;
+		this->flags[node] |= SPUN;
+	}
+}
+
+void SceneGraph::Update()
+{
+	this->updatedCount = 0;
+
+	for (size_t node = 0; node < this->parents.size(); node++)
+	{
+		int parent = this->parents[node];
+
+		// the parent was visited earlier in this same pass
+		bool moved = (this->flags[node] & MOVED) || (parent >= 0 && (this->flags[parent] & FRAME_CHANGED));
+		if (moved)
+		{
+			glm::mat4 parentFrame = (parent >= 0) ? this->frames[parent] : glm::mat4();
+			this->frames[node] = glm::translate(parentFrame, this->positions[node]);
+		}
+
+		if (moved || (this->flags[node] & SPUN))
+		{
+			// the spin axis keeps its direction in space as the body moves
+			this->worldMatrices[node] = this->frames[node] * this->shapes[node] *
+			                            glm::rotate(glm::mat4(), this->spins[node], glm::vec3(0, 1, 0));
+			this->updatedCount++;
+		}
+
+		this->flags[node] = moved ? FRAME_CHANGED : 0;
+	}
+}
+
+size_t SceneGraph::GetUpdatedCount() const
+{
+	return this->updatedCount;
+}
+
+const glm::mat4 &SceneGraph::GetWorldMatrix(int node) const
+{
+	return this->worldMatrices[node];
+}
+
+const glm::mat4 *SceneGraph::GetWorldMatrices() const
+{
+	return this->worldMatrices.empty() ? 0 : &this->worldMatrices[0];
+}
+
+glm::vec3 SceneGraph::GetWorldPosition(int node) const
+{
+	return glm::vec3(this->frames[node][3]);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+
+#include "glm/vec3.hpp"
+#include "glm/mat4x4.hpp"
+
+// a transform hierarchy flattened into arrays with every parent ahead of its
+// children, so one forward pass brings all world matrices up to date; only
+// nodes whose own state changed, or whose ancestors moved, are recomputed
+class SceneGraph {
+private:
+	// per node flags: MOVED and SPUN are set by SetLocal, FRAME_CHANGED by
+	// Update for nodes whose children have to follow them
+	enum { MOVED = 1, SPUN = 2, FRAME_CHANGED = 4 };
+
+	std::vector<int> parents;
+
+	// offset from the parent and angle about the node's own y axis
+	std::vector<glm::vec3> positions;
+	std::vector<float> spins;
+
+	// the part of the model matrix that never changes: scale then axial tilt
+	std::vector<glm::mat4> shapes;
+
+	// frames place a node's origin in the world and are what its children
+	// inherit; world matrices add its shape and spin, and sit next to each
+	// other for upload
+	std::vector<glm::mat4> frames;
+	std::vector<glm::mat4> worldMatrices;
+
+	std::vector<unsigned char> flags;
+	size_t updatedCount;
+
+public:
+	SceneGraph();
+
+	// adds a node under parent, or at the root for -1; a parent has to be
+	// added before its children, which keeps the arrays in update order
+	int AddNode(int parent, float scale, float axialTilt);
+	size_t GetCount() const;
+
+	// sets a node's offset from its parent and spin, marking it only if they changed
+	void SetLocal(int node, glm::vec3 position, float spin);
+
+	// recomputes the matrices of marked nodes and everything below the moved ones
+	void Update();
+
+	// nodes whose world matrix the last Update recomputed
+	size_t GetUpdatedCount() const;
+
+	const glm::mat4 &GetWorldMatrix(int node) const;
+	const glm::mat4 *GetWorldMatrices() const;
+	glm::vec3 GetWorldPosition(int node) const;
+};
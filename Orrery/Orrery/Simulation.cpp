@@ -0,0 +1,207 @@
+#include "Simulation.h"
+
+#include <algorithm>
+#include <math.h>
+
+#include "glm/common.hpp"
+
+using namespace std;
+
+// simulated seconds per gravity step, and the most steps taken in one tick;
+// past that the particles fall behind the clock rather than stalling the tick
+const double GRAVITY_STEP = 3600.0;
+const int GRAVITY_STEPS_PER_TICK = 4;
+
+// a background thread this many ticks behind skips ahead instead of catching up
+const int MAX_CATCHUP_TICKS = 8;
+
+const double TWO_PI = 6.28318530717958647692;
+
+Simulation::Simulation(BodyTable *bodies, GravitySimulation *gravity, double tick)
+{
+	this->bodies = bodies;
+	this->gravity = gravity;
+	this->ephemeris = 0;
+	this->tick = tick;
+	this->tickClock = 0;
+	this->time = 0;
+	this->timeScale = 1.0f;
+	this->paused = false;
+	this->running = false;
+	this->startTime = chrono::steady_clock::now();
+
+	// so the first frame has something to draw before any tick has run
+	this->bodies->Propagate(this->time);
+	Publish();
+}
+
+Simulation::~Simulation()
+{
+	Stop();
+}
+
+bool Simulation::SetEphemeris(const Ephemeris *ephemeris)
+{
+	if (ephemeris && ephemeris->GetBodyCount() != (int)this->bodies->GetCount())
+		return false;
+
+	this->ephemeris = ephemeris;
+	return true;
+}
+
+void Simulation::SetTimeScale(float timeScale)
+{
+	this->timeScale = timeScale;
+}
+
+void Simulation::SetPaused(bool paused)
+{
+	this->paused = paused;
+}
+
+double Simulation::Now() const
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - this->startTime).count();
+}
+
+bool Simulation::UsesEphemeris() const
+{
+	return this->ephemeris && this->ephemeris->Covers(this->time);
+}
+
+void Simulation::Tick()
+{
+	this->tickClock += this->tick;
+	if (!this->paused)
+		this->time += this->tick * this->timeScale;
+
+	if (!UsesEphemeris())
+		this->bodies->Propagate(this->time);
+
+	for (int step = 0; step < GRAVITY_STEPS_PER_TICK && this->gravity->GetCount() > 0 &&
+	     this->gravity->GetTime() + GRAVITY_STEP <= this->time; step++)
+		this->gravity->Step(GRAVITY_STEP);
+
+	Publish();
+}
+
+void Simulation::Publish()
+{
+	SimulationSnapshot &snapshot = this->snapshots.GetWriteBuffer();
+	snapshot.clock = this->tickClock;
+	snapshot.time = this->time;
+
+	size_t bodyCount = this->bodies->GetCount();
+	snapshot.bodyPositions.resize(bodyCount);
+	snapshot.spinAngles.resize(bodyCount);
+	if (UsesEphemeris())
+	{
+		for (size_t i = 0; i < bodyCount; i++)
+		{
+			glm::dvec3 position;
+			double spin;
+			this->ephemeris->Evaluate(i, this->time, &position, &spin);
+			snapshot.bodyPositions[i] = glm::vec3(position);
+			snapshot.spinAngles[i] = spin;
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < bodyCount; i++)
+		{
+			snapshot.bodyPositions[i] = this->bodies->GetPosition(i);
+			snapshot.spinAngles[i] = this->bodies->GetSpinAngle(i);
+		}
+	}
+
+	size_t gravityCount = this->gravity->GetCount();
+	snapshot.particlePositions.resize(gravityCount > 0 ? gravityCount - 1 : 0);
+	for (size_t i = 1; i < gravityCount; i++)
+		snapshot.particlePositions[i - 1] = glm::vec3(this->gravity->GetPosition(i) - this->gravity->GetPosition(0));
+
+	this->snapshots.Publish();
+}
+
+void Simulation::AdvanceTo(double clock)
+{
+	while (this->tickClock + this->tick <= clock)
+		Tick();
+}
+
+void Simulation::ThreadLoop()
+{
+	while (this->running)
+	{
+		// after a stall, such as a long gravity step, the missed ticks are
+		// dropped so the simulation does not spend the next frames racing
+		double now = Now();
+		if (now - this->tickClock > MAX_CATCHUP_TICKS * this->tick)
+			this->tickClock = now - this->tick;
+
+		AdvanceTo(now);
+		this_thread::sleep_until(this->startTime + chrono::duration_cast<chrono::steady_clock::duration>(
+			chrono::duration<double>(this->tickClock + this->tick)));
+	}
+}
+
+void Simulation::Start()
+{
+	if (this->running)
+		return;
+
+	// the clock starts now, not when the simulation was set up
+	this->startTime = chrono::steady_clock::now();
+	this->tickClock = 0;
+	this->running = true;
+	this->thread = std::thread(&Simulation::ThreadLoop, this);
+}
+
+void Simulation::Stop()
+{
+	if (!this->running)
+		return;
+
+	this->running = false;
+	this->thread.join();
+}
+
+void Simulation::Interpolate(double clock, SimulationSnapshot *state)
+{
+	if (this->snapshots.Acquire())
+	{
+		swap(this->previous, this->current);
+		this->current = this->snapshots.GetReadBuffer();
+	}
+
+	// the very first snapshot has nothing before it
+	if (this->previous.bodyPositions.size() != this->current.bodyPositions.size() ||
+	    this->previous.particlePositions.size() != this->current.particlePositions.size())
+		this->previous = this->current;
+
+	// a tick behind, the wanted clock almost always lies between the two
+	double span = this->current.clock - this->previous.clock;
+	float t = 1.0f;
+	if (span > 0)
+		t = min(max((clock - this->tick - this->previous.clock) / span, 0.0), 1.0);
+
+	state->clock = this->previous.clock + t * span;
+	state->time = this->previous.time + t * (this->current.time - this->previous.time);
+
+	size_t bodyCount = this->current.bodyPositions.size();
+	state->bodyPositions.resize(bodyCount);
+	state->spinAngles.resize(bodyCount);
+	for (size_t i = 0; i < bodyCount; i++)
+	{
+		state->bodyPositions[i] = glm::mix(this->previous.bodyPositions[i], this->current.bodyPositions[i], t);
+
+		// the short way round, since the angles wrap at pi
+		float turn = this->current.spinAngles[i] - this->previous.spinAngles[i];
+		turn -= TWO_PI * floor(turn / TWO_PI + 0.5);
+		state->spinAngles[i] = this->previous.spinAngles[i] + t * turn;
+	}
+
+	size_t particleCount = this->current.particlePositions.size();
+	state->particlePositions.resize(particleCount);
+	for (size_t i = 0; i < particleCount; i++)
+		state->particlePositions[i] = glm::mix(this->previous.particlePositions[i], this->current.particlePositions[i], t);
+}
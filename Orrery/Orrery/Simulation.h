@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include "glm/vec3.hpp"
+#include "BodyTable.h"
+#include "Gravity.h"
+#include "Ephemeris.h"
+#include "TripleBuffer.h"
+
+// everything the renderer needs from one simulation tick
+struct SimulationSnapshot
+{
+	// the simulation clock in real seconds when the tick ran, and the
+	// simulated seconds since the epoch it reached
+	double clock;
+	double time;
+
+	// one entry per row of the body table
+	std::vector<glm::vec3> bodyPositions;
+	std::vector<float> spinAngles;
+
+	// gravity bodies after the first, relative to the first
+	std::vector<glm::vec3> particlePositions;
+};
+
+// advances the body table and the gravity bodies in fixed ticks of real
+// time, usually on a thread of its own, publishing a snapshot after every
+// tick for the renderer to interpolate between
+class Simulation {
+private:
+	BodyTable *bodies;
+	GravitySimulation *gravity;
+	const Ephemeris *ephemeris;
+	double tick;
+
+	// owned by whichever thread is ticking
+	double tickClock;
+	double time;
+
+	// written by the render thread, read at each tick
+	std::atomic<float> timeScale;
+	std::atomic<bool> paused;
+
+	TripleBuffer<SimulationSnapshot> snapshots;
+
+	std::thread thread;
+	std::atomic<bool> running;
+	std::chrono::steady_clock::time_point startTime;
+
+	// owned by the render thread: the two latest snapshots it has taken
+	SimulationSnapshot previous, current;
+
+	bool UsesEphemeris() const;
+	void Tick();
+	void Publish();
+	void ThreadLoop();
+
+	Simulation(const Simulation &);
+	Simulation &operator=(const Simulation &);
+
+public:
+	// tick is in real seconds; each one advances simulated time by tick
+	// times the time scale
+	Simulation(BodyTable *bodies, GravitySimulation *gravity, double tick);
+	~Simulation();
+
+	// takes body states from a precomputed ephemeris with a body per row of
+	// the table wherever it covers the simulated time; set before Start
+	bool SetEphemeris(const Ephemeris *ephemeris);
+
+	void SetTimeScale(float timeScale);
+	void SetPaused(bool paused);
+
+	// seconds on the clock the background thread ticks to, from Start
+	double Now() const;
+
+	// runs every tick due up to a clock on the calling thread, which is how
+	// exported frames advance when there is no background thread
+	void AdvanceTo(double clock);
+
+	void Start();
+	void Stop();
+
+	// the state at a clock one tick behind the given one, interpolated
+	// between the snapshots either side of it; render thread only
+	void Interpolate(double clock, SimulationSnapshot *state);
+};
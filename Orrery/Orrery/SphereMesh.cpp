@@ -0,0 +1,63 @@
+#include "SphereMesh.h"
+
+#include <iostream>
+#include <math.h>
+
+using namespace std;
+
+bool BuildSphereMesh(int latEdges, int longEdges, vector<MyVertex> *vertices, vector<GLushort> *indices)
+{
+	// each latitude ring shares its vertices with the quads above and below it,
+	// the seam column is duplicated so that it can carry u = 1
+	int ringSize = longEdges + 1;
+	if ((latEdges + 1) * ringSize > 65536)
+	{
+		cout << "ERROR: sphere with " << latEdges << "x" << longEdges
+		     << " edges does not fit 16-bit indices" << endl;
+		return false;
+	}
+	
+	float dTheta = (2 * 3.1415926535) / longEdges;
+	float dPhi = 3.1415926535 / latEdges;
+	
+	for (int i = 0; i <= latEdges; i++)
+	{
+		// angle in radians of this latitude ring on the sphere
+		float p = 3.1415926535*2 - (i * dPhi);
+		
+		// v texture coord for points on this ring
+		float v = 1 - (p + 3.1415926535*2) / 3.1415926535;
+		
+		for (int j = 0; j <= longEdges; j++)
+		{
+			// angle in radians of longitude point on sphere
+			float t = j * dTheta;
+			
+			MyVertex vertex;
+			vertex.position = glm::vec3(cos(p) * sin(t), sin(p), cos(p) * cos(t));
+			vertex.normal = vertex.position;
+			vertex.textureCoord = glm::vec2(t / (2 * 3.1415926535), v);
+			vertices->push_back(vertex);
+		}
+	}
+	
+	for (int i = 0; i < latEdges; i++)
+	{
+		for (int j = 0; j < longEdges; j++)
+		{
+			// corners of the quad, numbered as in the original triangle soup
+			GLushort i1 = (i + 1) * ringSize + j;
+			GLushort i2 = i * ringSize + j;
+			GLushort i3 = i * ringSize + j + 1;
+			GLushort i4 = (i + 1) * ringSize + j + 1;
+			
+			// add first triangle
+			indices->push_back(i1); indices->push_back(i2); indices->push_back(i4);
+			
+			// add second triangle
+			indices->push_back(i4); indices->push_back(i2); indices->push_back(i3);
+		}
+	}
+	
+	return true;
+}
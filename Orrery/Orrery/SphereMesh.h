@@ -0,0 +1,10 @@
+#pragma once
+
+#include <vector>
+
+#include "structs.h"
+
+// builds a UV sphere of radius 1 as latEdges * longEdges quads sharing their
+// corners; each latitude ring's seam vertex is duplicated so it can carry
+// u = 1. Returns false if the vertices do not fit 16-bit indices
+bool BuildSphereMesh(int latEdges, int longEdges, std::vector<MyVertex> *vertices, std::vector<GLushort> *indices);
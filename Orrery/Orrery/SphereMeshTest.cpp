@@ -0,0 +1,122 @@
+// checks the indexed sphere mesh against the triangle soup it replaced:
+// vertex and index counts, and that expanding the indices gives back the
+// same triangles, corners, normals and texture coordinates in the same
+// order, so anything drawn with it looks the same
+#include <iostream>
+#include <math.h>
+
+#include "SphereMesh.h"
+
+using namespace std;
+
+// one corner of the original InitializeSphere's soup
+struct SoupVertex
+{
+	glm::vec3 position;
+	glm::vec2 textureCoord;
+};
+
+// the triangle soup as the original InitializeSphere emitted it
+static vector<SoupVertex> BuildSphereSoup(int latEdges, int longEdges)
+{
+	vector<SoupVertex> soup;
+	float dTheta = (2 * 3.1415926535) / longEdges;
+	float dPhi = 3.1415926535 / latEdges;
+
+	for (int i = 0; i < latEdges; i++)
+	{
+		float p1 = 3.1415926535*2 - ((i + 1) * dPhi);
+		float p2 = p1 + dPhi;
+		float v1 = 1 - (p1 + 3.1415926535*2) / 3.1415926535;
+		float v2 = 1 - (p2 + 3.1415926535*2) / 3.1415926535;
+
+		for (int j = 0; j < longEdges; j++)
+		{
+			float t1 = j * dTheta;
+			float t2 = t1 + dTheta;
+			float u1 = t1 / (2 * 3.1415926535);
+			float u2 = t2 / (2 * 3.1415926535);
+
+			SoupVertex c1 = { glm::vec3(cos(p1) * sin(t1), sin(p1), cos(p1) * cos(t1)), glm::vec2(u1, v1) };
+			SoupVertex c2 = { glm::vec3(cos(p2) * sin(t1), sin(p2), cos(p2) * cos(t1)), glm::vec2(u1, v2) };
+			SoupVertex c3 = { glm::vec3(cos(p2) * sin(t2), sin(p2), cos(p2) * cos(t2)), glm::vec2(u2, v2) };
+			SoupVertex c4 = { glm::vec3(cos(p1) * sin(t2), sin(p1), cos(p1) * cos(t2)), glm::vec2(u2, v1) };
+
+			soup.push_back(c1); soup.push_back(c2); soup.push_back(c4);
+			soup.push_back(c4); soup.push_back(c2); soup.push_back(c3);
+		}
+	}
+	return soup;
+}
+
+static bool Near(glm::vec3 a, glm::vec3 b)
+{
+	return fabs(a.x - b.x) < 1e-5f && fabs(a.y - b.y) < 1e-5f && fabs(a.z - b.z) < 1e-5f;
+}
+
+static bool Near(glm::vec2 a, glm::vec2 b)
+{
+	return fabs(a.x - b.x) < 1e-5f && fabs(a.y - b.y) < 1e-5f;
+}
+
+static int failures = 0;
+
+static void Check(bool condition, const string &what)
+{
+	if (!condition)
+	{
+		cout << "FAILED: " << what << endl;
+		failures++;
+	}
+}
+
+static void CheckSphere(int latEdges, int longEdges)
+{
+	string name = to_string(latEdges) + "x" + to_string(longEdges);
+	vector<MyVertex> vertices;
+	vector<GLushort> indices;
+	if (!BuildSphereMesh(latEdges, longEdges, &vertices, &indices))
+	{
+		Check(false, name + " builds");
+		return;
+	}
+
+	Check(vertices.size() == (size_t)(latEdges + 1) * (longEdges + 1), name + " vertex count");
+	Check(indices.size() == (size_t)latEdges * longEdges * 6, name + " index count");
+
+	vector<SoupVertex> soup = BuildSphereSoup(latEdges, longEdges);
+	Check(soup.size() == indices.size(), name + " draws as many corners as the soup");
+
+	size_t mismatches = 0;
+	for (size_t k = 0; k < soup.size() && k < indices.size(); k++)
+	{
+		if (indices[k] >= vertices.size())
+		{
+			mismatches++;
+			continue;
+		}
+		const MyVertex &vertex = vertices[indices[k]];
+		if (!Near(vertex.position, soup[k].position) || !Near(vertex.normal, soup[k].position) ||
+		    !Near(vertex.textureCoord, soup[k].textureCoord))
+			mismatches++;
+	}
+	Check(mismatches == 0, name + " matches the soup corner for corner (" + to_string(mismatches) + " differ)");
+}
+
+int main()
+{
+	// the original 40 x 80 sphere and every level of detail
+	CheckSphere(40, 80);
+	for (int latEdges = 8; latEdges <= 128; latEdges *= 2)
+		CheckSphere(latEdges, 2 * latEdges);
+
+	// too many vertices for 16-bit indices is refused, not wrapped
+	vector<MyVertex> vertices;
+	vector<GLushort> indices;
+	Check(!BuildSphereMesh(256, 512, &vertices, &indices), "256x512 is refused");
+
+	if (failures)
+		return 1;
+	cout << "SphereMeshTest passed" << endl;
+	return 0;
+}
@@ -0,0 +1,251 @@
+#include "StarCatalog.h"
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "soil/SOIL.h"
+
+using namespace std;
+
+const unsigned int STAR_CATALOG_MAGIC = 0x3154534f;	// "OST1"
+
+// the whole sky holds about 10^(SLOPE m + OFFSET) stars brighter than
+// magnitude m, from about 15 at first magnitude to 15000 at seventh
+const double STAR_COUNT_SLOPE = 0.5;
+const double STAR_COUNT_OFFSET = 0.7;
+
+// pixels darker than this are sky, not star
+const int STAR_THRESHOLD = 16;
+
+// half the width of the square a star's light is summed over
+const int STAR_WINDOW = 3;
+
+struct StarCatalogHeader
+{
+	unsigned int magic;
+	int count;
+
+	// the image the stars were found in
+	long long modifiedTime;
+	long long sourceSize;
+};
+
+StarCatalog::StarCatalog()
+{
+	this->header = 0;
+	this->stars = 0;
+}
+
+bool StarCatalog::Open(const string &filename, const string &imageFilename)
+{
+	Close();
+	if (!this->file.Open(filename))
+		return false;
+
+	const unsigned char *data = this->file.GetData();
+	size_t size = this->file.GetSize();
+	const StarCatalogHeader *header = (const StarCatalogHeader *)data;
+	bool valid = size >= sizeof(StarCatalogHeader) && header->magic == STAR_CATALOG_MAGIC && header->count >= 0 &&
+	             size == sizeof(StarCatalogHeader) + header->count * sizeof(StarRecord);
+
+	// a catalog shipped without its image is used as it is
+	long long modifiedTime, sourceSize;
+	if (valid && GetFileStamp(imageFilename, &modifiedTime, &sourceSize))
+		valid = modifiedTime == header->modifiedTime && sourceSize == header->sourceSize;
+
+	if (!valid)
+	{
+		this->file.Close();
+		return false;
+	}
+
+	this->header = header;
+	this->stars = (const StarRecord *)(data + sizeof(StarCatalogHeader));
+	return true;
+}
+
+void StarCatalog::Close()
+{
+	this->file.Close();
+	this->header = 0;
+	this->stars = 0;
+}
+
+bool StarCatalog::IsOpen() const
+{
+	return this->header != 0;
+}
+
+int StarCatalog::GetCount() const
+{
+	return this->header ? this->header->count : 0;
+}
+
+const StarRecord *StarCatalog::GetStars() const
+{
+	return this->stars;
+}
+
+static bool MagnitudeLess(float magnitude, const StarRecord &star)
+{
+	return magnitude < star.magnitude;
+}
+
+int StarCatalog::CountBrighterThan(float magnitude) const
+{
+	return upper_bound(this->stars, this->stars + GetCount(), magnitude, MagnitudeLess) - this->stars;
+}
+
+// a star found in a sky map, before it has a magnitude
+struct FoundStar
+{
+	StarRecord record;
+	double flux;
+};
+
+static bool FoundStarBrighter(const FoundStar &a, const FoundStar &b)
+{
+	return a.flux > b.flux;
+}
+
+bool BuildStarCatalog(const string &imageFilename, const string &filename)
+{
+	int width, height, channels;
+	unsigned char *pixels = SOIL_load_image(imageFilename.c_str(), &width, &height, &channels, SOIL_LOAD_RGB);
+	if (!pixels)
+	{
+		cout << "ERROR: Could not load sky map " << imageFilename << endl;
+		return false;
+	}
+
+	// neighbours wrap around in longitude and stop at the poles
+	vector<unsigned char> luminance(width * height);
+	for (int i = 0; i < width * height; i++)
+		luminance[i] = (pixels[3 * i] + pixels[3 * i + 1] + pixels[3 * i + 2]) / 3;
+
+	vector<FoundStar> found;
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			int centre = luminance[y * width + x];
+			if (centre < STAR_THRESHOLD)
+				continue;
+
+			// a star is a pixel no neighbour outshines; ties go to the first
+			// in reading order so a flat topped star is found once
+			bool isPeak = true;
+			for (int dy = -1; dy <= 1 && isPeak; dy++)
+			{
+				for (int dx = -1; dx <= 1 && isPeak; dx++)
+				{
+					int nx = (x + dx + width) % width, ny = min(max(y + dy, 0), height - 1);
+					int neighbour = luminance[ny * width + nx];
+					bool earlier = dy < 0 || (dy == 0 && dx < 0);
+					isPeak = (dx == 0 && dy == 0) || neighbour < centre || (neighbour == centre && !earlier);
+				}
+			}
+			if (!isPeak)
+				continue;
+
+			// the light around the peak gives the star's brightness, colour
+			// and a centre finer than a pixel
+			double flux = 0, red = 0, blue = 0, sumX = 0, sumY = 0;
+			for (int dy = -STAR_WINDOW; dy <= STAR_WINDOW; dy++)
+			{
+				for (int dx = -STAR_WINDOW; dx <= STAR_WINDOW; dx++)
+				{
+					int nx = (x + dx + width) % width, ny = min(max(y + dy, 0), height - 1);
+					const unsigned char *pixel = &pixels[3 * (ny * width + nx)];
+					double light = luminance[ny * width + nx];
+					flux += light;
+					red += pixel[0];
+					blue += pixel[2];
+					sumX += light * dx;
+					sumY += light * dy;
+				}
+			}
+
+			double u = (x + 0.5 + sumX / flux) / width;
+			double v = (y + 0.5 + sumY / flux) / height;
+			double longitude = 2 * 3.14159265358979 * u;
+			double latitude = 3.14159265358979 * (0.5 - v);
+
+			// neutral white is about an F star; every 2.5 in the index is a
+			// factor of ten between red and blue
+			double colourIndex = 0.4 + 2.5 * log10((red + 1) / (blue + 1));
+
+			FoundStar star;
+			star.record.direction[0] = cos(latitude) * sin(longitude);
+			star.record.direction[1] = sin(latitude);
+			star.record.direction[2] = cos(latitude) * cos(longitude);
+			star.record.magnitude = 0;
+			star.record.colourIndex = min(max(colourIndex, -0.4), 2.0);
+			star.flux = flux;
+			found.push_back(star);
+		}
+	}
+	SOIL_free_image_data(pixels);
+
+	if (found.empty())
+	{
+		cout << "ERROR: No stars found in " << imageFilename << endl;
+		return false;
+	}
+
+	// sky maps clip their brightest stars, so the image only ranks them;
+	// the nth brightest gets the magnitude the real sky has n stars above
+	stable_sort(found.begin(), found.end(), FoundStarBrighter);
+	vector<StarRecord> stars(found.size());
+	for (size_t i = 0; i < found.size(); i++)
+	{
+		stars[i] = found[i].record;
+		stars[i].magnitude = (log10(i + 1.0) - STAR_COUNT_OFFSET) / STAR_COUNT_SLOPE;
+	}
+
+	StarCatalogHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = STAR_CATALOG_MAGIC;
+	header.count = stars.size();
+	if (!GetFileStamp(imageFilename, &header.modifiedTime, &header.sourceSize))
+		return false;
+
+	// written under a temporary name and renamed into place, so a reader
+	// never maps a half written catalog
+	string temporary = filename + ".tmp";
+	{
+		ofstream output(temporary.c_str(), ios::binary);
+		if (!output)
+		{
+			cout << "ERROR: Could not write star catalog " << temporary << endl;
+			return false;
+		}
+		output.write((const char *)&header, sizeof(header));
+		output.write((const char *)&stars[0], stars.size() * sizeof(StarRecord));
+		if (!output.good())
+			return false;
+	}
+
+	remove(filename.c_str());
+	return rename(temporary.c_str(), filename.c_str()) == 0;
+}
+
+string StarCatalogFileName(const string &imageFilename)
+{
+	size_t dot = imageFilename.find_last_of('.');
+	return imageFilename.substr(0, dot) + ".stars";
+}
+
+bool LoadStarCatalog(const string &imageFilename, StarCatalog *catalog)
+{
+	string filename = StarCatalogFileName(imageFilename);
+	if (catalog->Open(filename, imageFilename))
+		return true;
+
+	return BuildStarCatalog(imageFilename, filename) && catalog->Open(filename, imageFilename);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+
+#include "MappedFile.h"
+
+// one star as stored in a catalog, laid out to be uploaded as a vertex
+struct StarRecord
+{
+	// unit vector towards the star, y towards the north pole of the sky
+	float direction[3];
+
+	// apparent magnitude, smaller for brighter stars
+	float magnitude;
+
+	// B - V, from about -0.4 for blue stars to 2 for red ones
+	float colourIndex;
+};
+
+struct StarCatalogHeader;
+
+// a compiled star catalog, brightest star first, mapped straight from its
+// file and read in place
+class StarCatalog {
+private:
+	MappedFile file;
+	const StarCatalogHeader *header;
+	const StarRecord *stars;
+
+	StarCatalog(const StarCatalog &);
+	StarCatalog &operator=(const StarCatalog &);
+
+public:
+	StarCatalog();
+
+	// maps a catalog, returning false if it is missing, malformed or older
+	// than the image it was found in
+	bool Open(const std::string &filename, const std::string &imageFilename);
+	void Close();
+	bool IsOpen() const;
+
+	int GetCount() const;
+	const StarRecord *GetStars() const;
+
+	// how many stars from the start are at least as bright as a magnitude
+	int CountBrighterThan(float magnitude) const;
+};
+
+// finds the stars in an equirectangular sky map, north at the top, and
+// writes them out as a catalog, with magnitudes following the real sky's
+// star counts in the map's order of brightness
+bool BuildStarCatalog(const std::string &imageFilename, const std::string &filename);
+
+// the catalog found in a sky map, kept beside it with a .stars extension
+std::string StarCatalogFileName(const std::string &imageFilename);
+
+// opens the catalog of a sky map, building it first whenever the image changes
+bool LoadStarCatalog(const std::string &imageFilename, StarCatalog *catalog);
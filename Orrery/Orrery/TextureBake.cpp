@@ -0,0 +1,162 @@
+// ==========================================================================
+// Offline texture baker
+//
+// Converts JPEG/PNG images into block compressed .dds files with a full
+// mip chain (DXT1 for RGB, DXT5 for RGBA) next to the source image, which
+// the orrery then uploads directly with glCompressedTexImage3D. With
+// --cubemap, equirectangular sky images become DXT1 cube maps instead,
+// saved as <name>_cube.dds.
+//
+// usage: texbake [--cubemap] image [image ...]
+// ==========================================================================
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <math.h>
+
+#include "DDSFile.h"
+#include "soil/SOIL.h"
+
+using namespace std;
+
+bool BakeImage(const string &imageFileName)
+{
+	int w, h, channels;
+	unsigned char *pixels = SOIL_load_image(imageFileName.c_str(), &w, &h, &channels, SOIL_LOAD_AUTO);
+	if (!pixels)
+	{
+		cout << "ERROR: Could not load " << imageFileName << endl;
+		return false;
+	}
+
+	// grey and grey-alpha images are expanded to what the encoder takes
+	if (channels != 3 && channels != 4)
+	{
+		SOIL_free_image_data(pixels);
+		int forced = (channels == 2) ? SOIL_LOAD_RGBA : SOIL_LOAD_RGB;
+		pixels = SOIL_load_image(imageFileName.c_str(), &w, &h, &channels, forced);
+		channels = forced;
+		if (!pixels)
+			return false;
+	}
+
+	DDSImage image;
+	bool compressed = CompressToDDS(pixels, w, h, channels, &image);
+	SOIL_free_image_data(pixels);
+	if (!compressed)
+		return false;
+
+	string ddsFileName = DDSFileName(imageFileName);
+	if (!SaveDDS(ddsFileName, image))
+		return false;
+
+	cout << imageFileName << " -> " << ddsFileName << " (" << w << "x" << h << ", "
+	     << image.levels << " levels, " << image.data.size() / 1024 << " KB, "
+	     << (channels == 4 ? "DXT5" : "DXT1") << ")" << endl;
+	return true;
+}
+
+// bilinearly filtered texel of an equirectangular RGB image in the
+// direction (x, y, z), y towards the top of the image and z its centre
+static void SampleEquirectangular(const unsigned char *pixels, int w, int h, double x, double y, double z,
+                                  unsigned char *texel)
+{
+	const double PI = 3.14159265358979;
+	double longitude = atan2(x, z);
+	double latitude = atan2(y, sqrt(x * x + z * z));
+	double u = longitude / (2 * PI);
+	u = (u - floor(u)) * w - 0.5;
+	double v = (0.5 - latitude / PI) * h - 0.5;
+
+	// columns wrap around, rows stop at the poles
+	int x0 = (int)floor(u), y0 = (int)floor(v);
+	double fx = u - x0, fy = v - y0;
+	int columns[2] = { (x0 % w + w) % w, ((x0 + 1) % w + w) % w };
+	int rows[2] = { max(0, min(h - 1, y0)), max(0, min(h - 1, y0 + 1)) };
+
+	for (int channel = 0; channel < 3; channel++)
+	{
+		double top = pixels[3 * (rows[0] * w + columns[0]) + channel] * (1 - fx) + pixels[3 * (rows[0] * w + columns[1]) + channel] * fx;
+		double bottom = pixels[3 * (rows[1] * w + columns[0]) + channel] * (1 - fx) + pixels[3 * (rows[1] * w + columns[1]) + channel] * fx;
+		texel[channel] = (unsigned char)(top * (1 - fy) + bottom * fy + 0.5);
+	}
+}
+
+bool BakeCubeMap(const string &imageFileName)
+{
+	int w, h, channels;
+	unsigned char *pixels = SOIL_load_image(imageFileName.c_str(), &w, &h, &channels, SOIL_LOAD_RGB);
+	if (!pixels)
+	{
+		cout << "ERROR: Could not load " << imageFileName << endl;
+		return false;
+	}
+
+	// a face spans a quarter of the way round, as the image's height spans
+	// half, so the largest power of two no more than half the height keeps
+	// its detail
+	int size = 1;
+	while (size * 4 <= h)
+		size *= 2;
+
+	DDSImage cube;
+	vector<unsigned char> face((size_t)size * size * 3);
+	for (int f = 0; f < 6; f++)
+	{
+		for (int row = 0; row < size; row++)
+		{
+			for (int column = 0; column < size; column++)
+			{
+				// where each texel of each face looks, as OpenGL samples cube maps
+				double s = 2.0 * (column + 0.5) / size - 1, t = 2.0 * (row + 0.5) / size - 1;
+				const double directions[6][3] = { { 1, -t, -s }, { -1, -t, s }, { s, 1, t },
+				                                  { s, -1, -t }, { s, -t, 1 }, { -s, -t, -1 } };
+				const double *d = directions[f];
+				SampleEquirectangular(pixels, w, h, d[0], d[1], d[2], &face[3 * ((size_t)row * size + column)]);
+			}
+		}
+
+		DDSImage faceImage;
+		if (!CompressToDDS(&face[0], size, size, 3, &faceImage))
+		{
+			SOIL_free_image_data(pixels);
+			return false;
+		}
+		if (f == 0)
+			cube = faceImage;
+		else
+			cube.data.insert(cube.data.end(), faceImage.data.begin(), faceImage.data.end());
+	}
+	SOIL_free_image_data(pixels);
+	cube.faces = 6;
+
+	string ddsFileName = DDSCubeMapFileName(imageFileName);
+	if (!SaveDDS(ddsFileName, cube))
+		return false;
+
+	cout << imageFileName << " -> " << ddsFileName << " (6 faces of " << size << "x" << size << ", "
+	     << cube.levels << " levels, " << cube.data.size() / 1024 << " KB, DXT1)" << endl;
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	bool cubeMap = argc > 1 && string(argv[1]) == "--cubemap";
+	int first = cubeMap ? 2 : 1;
+	if (argc <= first)
+	{
+		cout << "usage: texbake [--cubemap] image [image ...]" << endl;
+		return -1;
+	}
+
+	int failures = 0;
+	for (int i = first; i < argc; i++)
+	{
+		if (!(cubeMap ? BakeCubeMap(argv[i]) : BakeImage(argv[i])))
+			failures++;
+	}
+
+	return failures ? -1 : 0;
+}
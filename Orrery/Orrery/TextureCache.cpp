@@ -0,0 +1,172 @@
+#include "TextureCache.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include "soil/image_helper.h"
+
+using namespace std;
+
+const unsigned int TEXTURE_CACHE_MAGIC = 0x3143544f;	// "OTC1"
+
+// what a cache entry was made from; if any of it differs the entry is stale
+struct TextureCacheHeader
+{
+	unsigned int magic;
+	int channels;
+	long long modifiedTime;
+	long long sourceSize;
+	int width, height;
+	int levels;
+
+	// the source path follows the header, then the texels
+	int pathLength;
+};
+
+// entries are named by a hash of the source path, which the header repeats
+// in full to rule out collisions
+static string CacheFileName(const string &cacheDirectory, const string &imageFileName, int channels)
+{
+	// 64-bit FNV-1a
+	unsigned long long hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < imageFileName.size(); i++)
+	{
+		hash ^= (unsigned char)imageFileName[i];
+		hash *= 1099511628211ULL;
+	}
+
+	char name[32];
+	sprintf(name, "%016llx-%d.tex", hash, channels);
+	return cacheDirectory + name;
+}
+
+// offsets of each level of the chain BuildMipChain makes, returning its total size
+static size_t MipChainLayout(int width, int height, int channels, vector<size_t> *levelOffsets)
+{
+	size_t total = 0;
+	levelOffsets->clear();
+	while (true)
+	{
+		levelOffsets->push_back(total);
+		total += (size_t)width * height * channels;
+		if (width == 1 && height == 1)
+			break;
+		width = max(1, width / 2);
+		height = max(1, height / 2);
+	}
+	return total;
+}
+
+void BuildMipChain(const unsigned char *pixels, int width, int height, int channels,
+                   vector<unsigned char> *texels, vector<size_t> *levelOffsets)
+{
+	texels->resize(MipChainLayout(width, height, channels, levelOffsets));
+	memcpy(&(*texels)[0], pixels, (size_t)width * height * channels);
+
+	for (size_t level = 1; level < levelOffsets->size(); level++)
+	{
+		mipmap_image(&(*texels)[(*levelOffsets)[level - 1]], width, height, channels,
+		             &(*texels)[(*levelOffsets)[level]], width > 1 ? 2 : 1, height > 1 ? 2 : 1);
+		width = max(1, width / 2);
+		height = max(1, height / 2);
+	}
+}
+
+bool LoadCachedTexture(const string &cacheDirectory, const string &imageFileName, int channels,
+                       MappedFile *file, CachedTexture *texture)
+{
+	long long modifiedTime, sourceSize;
+	if (!GetFileStamp(imageFileName, &modifiedTime, &sourceSize))
+		return false;
+	if (!file->Open(CacheFileName(cacheDirectory, imageFileName, channels)))
+		return false;
+
+	const unsigned char *data = file->GetData();
+	TextureCacheHeader header;
+	if (file->GetSize() < sizeof(header))
+	{
+		file->Close();
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
+
+	size_t texelsOffset = sizeof(header) + header.pathLength;
+	if (header.magic != TEXTURE_CACHE_MAGIC || header.channels != channels ||
+	    header.modifiedTime != modifiedTime || header.sourceSize != sourceSize ||
+	    header.pathLength != (int)imageFileName.size() || file->GetSize() < texelsOffset ||
+	    memcmp(data + sizeof(header), imageFileName.data(), header.pathLength) != 0)
+	{
+		file->Close();
+		return false;
+	}
+
+	texture->width = header.width;
+	texture->height = header.height;
+	texture->channels = channels;
+	size_t total = MipChainLayout(header.width, header.height, channels, &texture->levelOffsets);
+	texture->levels = texture->levelOffsets.size();
+	if (texture->levels != header.levels || file->GetSize() != texelsOffset + total)
+	{
+		file->Close();
+		return false;
+	}
+
+	texture->texels = data + texelsOffset;
+	return true;
+}
+
+bool SaveCachedTexture(const string &cacheDirectory, const string &imageFileName, int channels,
+                       int width, int height, const vector<unsigned char> &texels)
+{
+	TextureCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	if (!GetFileStamp(imageFileName, &header.modifiedTime, &header.sourceSize))
+		return false;
+
+	vector<size_t> levelOffsets;
+	header.magic = TEXTURE_CACHE_MAGIC;
+	header.channels = channels;
+	header.width = width;
+	header.height = height;
+	if (MipChainLayout(width, height, channels, &levelOffsets) != texels.size())
+		return false;
+	header.levels = levelOffsets.size();
+	header.pathLength = imageFileName.size();
+
+	// the directory usually exists already, in which case this fails harmlessly
+	string directory = cacheDirectory.substr(0, cacheDirectory.find_last_not_of("/\\") + 1);
+#ifdef _WIN32
+	_mkdir(directory.c_str());
+#else
+	mkdir(directory.c_str(), 0755);
+#endif
+
+	// written under a temporary name and renamed into place, so a reader
+	// never maps a half written entry
+	string filename = CacheFileName(cacheDirectory, imageFileName, channels);
+	string temporary = filename + ".tmp";
+	{
+		ofstream output(temporary.c_str(), ios::binary);
+		if (!output)
+		{
+			cout << "ERROR: Could not write texture cache " << temporary << endl;
+			return false;
+		}
+		output.write((const char *)&header, sizeof(header));
+		output.write(imageFileName.data(), imageFileName.size());
+		output.write((const char *)&texels[0], texels.size());
+		if (!output.good())
+			return false;
+	}
+
+	remove(filename.c_str());
+	return rename(temporary.c_str(), filename.c_str()) == 0;
+}
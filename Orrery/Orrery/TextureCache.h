@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+// decoded texels of one image with its full mip chain, as stored in the cache
+struct CachedTexture
+{
+	int width, height;
+	int channels;
+	int levels;
+
+	// every level back to back, largest first, rows tightly packed
+	const unsigned char *texels;
+	std::vector<size_t> levelOffsets;
+
+	CachedTexture() : width(0), height(0), channels(0), levels(0), texels(0)
+	{}
+};
+
+// builds the box filtered mip chain of an 8-bit image down to 1x1
+void BuildMipChain(const unsigned char *pixels, int width, int height, int channels,
+                   std::vector<unsigned char> *texels, std::vector<size_t> *levelOffsets);
+
+// maps the cache entry for an image decoded to the given channel count,
+// returning false if there is none or the image has changed since it was made
+bool LoadCachedTexture(const std::string &cacheDirectory, const std::string &imageFileName, int channels,
+                       MappedFile *file, CachedTexture *texture);
+
+// writes a cache entry for an image from the texels BuildMipChain produced
+bool SaveCachedTexture(const std::string &cacheDirectory, const std::string &imageFileName, int channels,
+                       int width, int height, const std::vector<unsigned char> &texels);
@@ -0,0 +1,449 @@
+#include "TextureLoader.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <string.h>
+
+#include "soil/SOIL.h"
+
+using namespace std;
+
+// defined with the other OpenGL utility functions in boilerplate.cpp
+bool CheckGLErrors();
+
+// S3TC formats are an extension rather than core OpenGL, but every desktop driver has them
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT  0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+static GLenum CompressedFormat(unsigned int fourCC)
+{
+	return (fourCC == DDS_FOURCC_DXT5) ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+	                                   : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+}
+
+static bool FileExists(const string &fileName)
+{
+	ifstream input(fileName.c_str(), ios::binary);
+	return input.good();
+}
+
+TextureLoader::TextureLoader(int threadCount, const string &cacheDirectory)
+{
+	this->stopping = false;
+	this->cacheDirectory = cacheDirectory;
+	this->pixelBuffers[0] = this->pixelBuffers[1] = 0;
+	this->nextPixelBuffer = 0;
+
+	for (int i = 0; i < max(1, threadCount); i++)
+		this->workers.push_back(thread(&TextureLoader::WorkerLoop, this));
+}
+
+TextureLoader::~TextureLoader()
+{
+	Shutdown();
+}
+
+bool TextureLoader::Load(MyTexture *texture, const vector<string> &imageFileNames)
+{
+	// the placeholder is a 1x1 mid grey texel per layer, so layer indices
+	// used by instances are valid from the first frame
+	vector<unsigned char> grey(imageFileNames.size() * 3, 128);
+
+	texture->width = texture->height = 1;
+	texture->layers = imageFileNames.size();
+
+	if (!texture->textureName)
+		glGenTextures(1, &texture->textureName);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture->textureName);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB8, 1, 1, texture->layers, 0, GL_RGB, GL_UNSIGNED_BYTE, &grey[0]);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	// baked files are only used when every layer has one, so that all
+	// layers of the array share a format
+	bool compressed = true;
+	for (size_t layer = 0; layer < imageFileNames.size(); layer++)
+		compressed = compressed && FileExists(DDSFileName(imageFileNames[layer]));
+
+	PendingTexture target;
+	target.texture = texture;
+	target.textureName = 0;
+	target.layersLeft = texture->layers;
+	target.allocated = false;
+	target.failed = false;
+	target.fourCC = 0;
+	target.width = target.height = target.levels = 0;
+	this->pending.push_back(target);
+
+	{
+		lock_guard<mutex> lock(this->queueMutex);
+		for (size_t layer = 0; layer < imageFileNames.size(); layer++)
+		{
+			DecodeJob job;
+			job.texture = texture;
+			job.layer = layer;
+			job.fileName = imageFileNames[layer];
+			job.compressed = compressed;
+			this->jobs.push_back(job);
+		}
+	}
+	this->jobAvailable.notify_all();
+
+	return !CheckGLErrors();
+}
+
+void TextureLoader::WorkerLoop()
+{
+	while (true)
+	{
+		DecodeJob job;
+		{
+			unique_lock<mutex> lock(this->queueMutex);
+			while (this->jobs.empty() && !this->stopping)
+				this->jobAvailable.wait(lock);
+			if (this->stopping)
+				return;
+			job = this->jobs.front();
+			this->jobs.pop_front();
+		}
+
+		DecodedLayer *result = new DecodedLayer();
+		Decode(job, result);
+
+		lock_guard<mutex> lock(this->queueMutex);
+		this->decoded.push_back(result);
+	}
+}
+
+void TextureLoader::Decode(const DecodeJob &job, DecodedLayer *result)
+{
+	result->texture = job.texture;
+	result->layer = job.layer;
+	result->fileName = job.fileName;
+
+	if (job.compressed)
+	{
+		if (LoadDDS(DDSFileName(job.fileName), &result->dds))
+		{
+			result->fourCC = result->dds.fourCC;
+			result->width = result->dds.width;
+			result->height = result->dds.height;
+			result->levels = result->dds.levels;
+			result->texels = &result->dds.data[0];
+			result->levelOffsets = result->dds.levelOffsets;
+		}
+		return;
+	}
+
+	CachedTexture cached;
+	if (LoadCachedTexture(this->cacheDirectory, job.fileName, 3, &result->cacheFile, &cached))
+	{
+		result->width = cached.width;
+		result->height = cached.height;
+		result->levels = cached.levels;
+		result->texels = cached.texels;
+		result->levelOffsets = cached.levelOffsets;
+		return;
+	}
+
+	// SOIL_load_image will return NULL if it fails
+	int w, h;
+	unsigned char *pixels = SOIL_load_image(job.fileName.c_str(), &w, &h, 0, SOIL_LOAD_RGB);
+	if (!pixels)
+		return;
+
+	BuildMipChain(pixels, w, h, 3, &result->decoded, &result->levelOffsets);
+	SOIL_free_image_data(pixels);
+
+	// if the entry cannot be written the image is simply decoded again next run
+	SaveCachedTexture(this->cacheDirectory, job.fileName, 3, w, h, result->decoded);
+
+	result->width = w;
+	result->height = h;
+	result->levels = result->levelOffsets.size();
+	result->texels = &result->decoded[0];
+}
+
+TextureLoader::PendingTexture *TextureLoader::FindPending(MyTexture *texture)
+{
+	for (size_t i = 0; i < this->pending.size(); i++)
+	{
+		if (this->pending[i].texture == texture)
+			return &this->pending[i];
+	}
+	return 0;
+}
+
+// creates the real storage for a texture from the first of its layers to be
+// decoded, or checks a later layer against it
+bool TextureLoader::Allocate(PendingTexture *target, DecodedLayer *layer)
+{
+	if (layer->levels == 0)
+	{
+		cout << "ERROR: could not load " << layer->fileName << endl;
+		return false;
+	}
+
+	if (target->allocated)
+	{
+		if (layer->width != target->width || layer->height != target->height ||
+		    layer->fourCC != target->fourCC || layer->levels != target->levels)
+		{
+			cout << "ERROR: " << layer->fileName << " is " << layer->width << "x" << layer->height
+			     << ", texture array layers are " << target->width << "x" << target->height << endl;
+			return false;
+		}
+		return true;
+	}
+
+	target->width = layer->width;
+	target->height = layer->height;
+	target->fourCC = layer->fourCC;
+	target->levels = layer->levels;
+
+	glGenTextures(1, &target->textureName);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, target->textureName);
+
+	int w = target->width, h = target->height;
+	for (int level = 0; level < target->levels; level++)
+	{
+		if (target->fourCC)
+		{
+			GLsizei levelSize = DDSLevelSize(target->fourCC, w, h);
+			glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, CompressedFormat(target->fourCC), w, h,
+			                       target->texture->layers, 0, levelSize * target->texture->layers, 0);
+		}
+		else
+		{
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGB8, w, h, target->texture->layers,
+			             0, GL_RGB, GL_UNSIGNED_BYTE, 0);
+		}
+		w = max(1, w / 2);
+		h = max(1, h / 2);
+	}
+
+	target->allocated = true;
+	return true;
+}
+
+// copies the next rows of a layer into a pixel buffer object and from there
+// into the texture, returning the number of bytes uploaded
+size_t TextureLoader::UploadSlice(PendingTexture *target, DecodedLayer *layer, size_t byteBudget)
+{
+	int w = max(1, target->width >> layer->level);
+	int h = max(1, target->height >> layer->level);
+
+	// compressed data is uploaded in whole rows of 4x4 blocks
+	bool compressed = target->fourCC != 0;
+	int rowStep = compressed ? 4 : 1;
+	size_t rowBytes = compressed ? DDSLevelSize(target->fourCC, w, 1) : (size_t)w * 3;
+	int rowsLeft = h - layer->row;
+	int rows = (int)min((size_t)rowsLeft, max((size_t)1, byteBudget / rowBytes) * rowStep);
+	if (rows < rowsLeft)
+		rows = max(rowStep, rows - rows % rowStep);
+	size_t bytes = (size_t)((rows + rowStep - 1) / rowStep) * rowBytes;
+
+	// for a cached image this reads straight from the mapped file, so the
+	// only copy made on the way to the driver is into the pixel buffer
+	const unsigned char *source = layer->texels + layer->levelOffsets[layer->level] + (layer->row / rowStep) * rowBytes;
+
+	// alternate between two buffers and orphan the one we write to, so the
+	// driver never has to wait for the previous transfer to finish
+	GLuint pixelBuffer = this->pixelBuffers[this->nextPixelBuffer];
+	this->nextPixelBuffer = 1 - this->nextPixelBuffer;
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, 0, GL_STREAM_DRAW);
+	void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (mapped)
+	{
+		memcpy(mapped, source, bytes);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+		glBindTexture(GL_TEXTURE_2D_ARRAY, target->textureName);
+		if (compressed)
+		{
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, layer->level, 0, layer->row, layer->layer,
+			                          w, rows, 1, CompressedFormat(target->fourCC), bytes, 0);
+		}
+		else
+		{
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, layer->level, 0, layer->row, layer->layer,
+			                w, rows, 1, GL_RGB, GL_UNSIGNED_BYTE, 0);
+		}
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	layer->row += rows;
+	if (layer->row >= h)
+	{
+		layer->row = 0;
+		layer->level++;
+	}
+
+	return bytes;
+}
+
+// replaces the placeholder with the fully uploaded texture
+void TextureLoader::Complete(PendingTexture *target)
+{
+	MyTexture *texture = target->texture;
+
+	// every layer arrives with its whole mip chain, so none are generated here
+	glBindTexture(GL_TEXTURE_2D_ARRAY, target->textureName);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, target->levels - 1);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	glDeleteTextures(1, &texture->textureName);
+	texture->textureName = target->textureName;
+	texture->width = target->width;
+	texture->height = target->height;
+}
+
+bool TextureLoader::Update(size_t byteBudget)
+{
+	{
+		lock_guard<mutex> lock(this->queueMutex);
+		while (!this->decoded.empty())
+		{
+			this->uploading.push_back(this->decoded.front());
+			this->decoded.pop_front();
+		}
+	}
+
+	if (this->uploading.empty())
+		return false;
+
+	if (!this->pixelBuffers[0])
+		glGenBuffers(2, this->pixelBuffers);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	// always make some progress, even with a budget smaller than one row
+	size_t uploaded = 0;
+	do
+	{
+		DecodedLayer *layer = this->uploading.front();
+		PendingTexture *target = FindPending(layer->texture);
+
+		bool done = true;
+		if (!target->failed && Allocate(target, layer))
+		{
+			uploaded += UploadSlice(target, layer, byteBudget - uploaded);
+			done = layer->level >= target->levels;
+		}
+		else
+		{
+			target->failed = true;
+		}
+
+		if (done)
+		{
+			this->uploading.pop_front();
+			delete layer;
+
+			if (--target->layersLeft == 0)
+			{
+				// a texture with a bad layer keeps its placeholder
+				if (!target->failed)
+					Complete(target);
+				else if (target->textureName)
+					glDeleteTextures(1, &target->textureName);
+				this->pending.erase(this->pending.begin() + (target - &this->pending[0]));
+			}
+		}
+	} while (!this->uploading.empty() && uploaded < byteBudget);
+
+	CheckGLErrors();
+	return true;
+}
+
+void TextureLoader::Finish()
+{
+	while (!IsIdle())
+	{
+		if (!Update((size_t)-1))
+			this_thread::yield();
+	}
+}
+
+bool TextureLoader::IsIdle()
+{
+	return this->pending.empty();
+}
+
+void TextureLoader::Shutdown()
+{
+	{
+		lock_guard<mutex> lock(this->queueMutex);
+		this->stopping = true;
+		this->jobs.clear();
+	}
+	this->jobAvailable.notify_all();
+
+	for (size_t i = 0; i < this->workers.size(); i++)
+		this->workers[i].join();
+	this->workers.clear();
+
+	// layers that were decoded but never uploaded
+	this->uploading.insert(this->uploading.end(), this->decoded.begin(), this->decoded.end());
+	this->decoded.clear();
+	for (size_t i = 0; i < this->uploading.size(); i++)
+		delete this->uploading[i];
+	this->uploading.clear();
+
+	if (this->pixelBuffers[0])
+	{
+		glDeleteBuffers(2, this->pixelBuffers);
+		this->pixelBuffers[0] = this->pixelBuffers[1] = 0;
+	}
+}
+
+bool LoadCubeMap(MyTexture *texture, const string &ddsFileName)
+{
+	DDSImage image;
+	if (!FileExists(ddsFileName) || !LoadDDS(ddsFileName, &image))
+		return false;
+	if (image.faces != 6)
+	{
+		cout << "ERROR: " << ddsFileName << " is not a cube map" << endl;
+		return false;
+	}
+
+	glGenTextures(1, &texture->textureName);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, texture->textureName);
+
+	// each face holds a whole mip chain, one face after another
+	size_t faceSize = image.data.size() / 6;
+	for (int face = 0; face < 6; face++)
+	{
+		int w = image.width, h = image.height;
+		for (int level = 0; level < image.levels; level++)
+		{
+			glCompressedTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, CompressedFormat(image.fourCC), w, h, 0,
+			                       image.levelSizes[level], &image.data[face * faceSize + image.levelOffsets[level]]);
+			w = max(1, w / 2);
+			h = max(1, h / 2);
+		}
+	}
+
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, image.levels - 1);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+	texture->width = image.width;
+	texture->height = image.height;
+	texture->layers = 1;
+	return !CheckGLErrors();
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "structs.h"
+#include "DDSFile.h"
+#include "TextureCache.h"
+
+// one layer of an array texture, decoded by a worker thread and then
+// uploaded a slice at a time by the OpenGL thread
+struct DecodedLayer
+{
+	MyTexture *texture;
+	GLuint layer;
+	std::string fileName;
+
+	// 0 for uncompressed RGB texels, otherwise the DDS four character code;
+	// no levels means the image could not be loaded
+	unsigned int fourCC;
+	int width, height;
+	int levels;
+
+	// every mip level back to back, pointing into whichever of the mapped
+	// cache entry, the .dds image or the freshly decoded chain holds them
+	const unsigned char *texels;
+	std::vector<size_t> levelOffsets;
+	MappedFile cacheFile;
+	DDSImage dds;
+	std::vector<unsigned char> decoded;
+
+	// upload progress: current mip level and first row not yet uploaded
+	int level;
+	int row;
+
+	DecodedLayer() : texture(0), layer(0), fourCC(0), width(0), height(0), levels(0), texels(0), level(0), row(0)
+	{}
+};
+
+// decodes images on a pool of worker threads and streams them into array
+// textures through pixel buffer objects, so the first frame does not wait on
+// JPEG/PNG decoding; textures show a grey placeholder until all their layers
+// have arrived. Decoded images are kept in an on-disk cache, so later runs
+// map them instead of decoding again
+class TextureLoader {
+private:
+	// a texture whose real storage is being filled in behind its placeholder
+	struct PendingTexture
+	{
+		MyTexture *texture;
+		GLuint textureName;
+		GLuint layersLeft;
+		bool allocated;
+		bool failed;
+		unsigned int fourCC;
+		int width, height, levels;
+	};
+
+	struct DecodeJob
+	{
+		MyTexture *texture;
+		GLuint layer;
+		std::string fileName;
+		bool compressed;
+	};
+
+	std::vector<std::thread> workers;
+	std::mutex queueMutex;
+	std::condition_variable jobAvailable;
+	std::deque<DecodeJob> jobs;
+	std::deque<DecodedLayer *> decoded;
+	bool stopping;
+	std::string cacheDirectory;
+
+	// owned by the OpenGL thread only
+	std::vector<PendingTexture> pending;
+	std::deque<DecodedLayer *> uploading;
+	GLuint pixelBuffers[2];
+	int nextPixelBuffer;
+
+	void WorkerLoop();
+	void Decode(const DecodeJob &job, DecodedLayer *result);
+
+	PendingTexture *FindPending(MyTexture *texture);
+	bool Allocate(PendingTexture *target, DecodedLayer *layer);
+	size_t UploadSlice(PendingTexture *target, DecodedLayer *layer, size_t byteBudget);
+	void Complete(PendingTexture *target);
+
+public:
+	TextureLoader(int threadCount, const std::string &cacheDirectory);
+	~TextureLoader();
+
+	// gives the texture a grey placeholder with one layer per image and queues
+	// the images for decoding, preferring baked .dds files if all layers have one
+	bool Load(MyTexture *texture, const std::vector<std::string> &imageFileNames);
+
+	// uploads up to byteBudget bytes of decoded texels and swaps in textures
+	// whose layers are all present; returns true if it changed any texture
+	// or buffer bindings
+	bool Update(size_t byteBudget);
+
+	// decodes and uploads everything still outstanding before returning
+	void Finish();
+
+	bool IsIdle();
+
+	// stops the workers and deletes the pixel buffers, while the context is current
+	void Shutdown();
+};
+
+// uploads a cube map baked by texbake --cubemap in one go, small enough not
+// to need streaming; returns false if the file is missing or not a cube map
+bool LoadCubeMap(MyTexture *texture, const std::string &ddsFileName);
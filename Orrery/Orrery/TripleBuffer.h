@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+
+// hands values from one writing thread to one reading thread without locks:
+// the writer fills a buffer of its own and swaps it with the one in the
+// middle, the reader swaps its buffer with the middle when that is newer, so
+// neither ever waits and the reader always gets the latest complete value
+template <typename T>
+class TripleBuffer {
+private:
+	// the middle buffer's index, with FRESH set while the reader has not taken it
+	static const int FRESH = 4;
+	static const int INDEX_MASK = 3;
+
+	T buffers[3];
+	std::atomic<int> middle;
+	int back;
+	int front;
+
+	TripleBuffer(const TripleBuffer &);
+	TripleBuffer &operator=(const TripleBuffer &);
+
+public:
+	TripleBuffer()
+	{
+		this->front = 0;
+		this->middle = 1;
+		this->back = 2;
+	}
+
+	// writer side: the buffer to fill, then Publish to hand it over
+	T &GetWriteBuffer()
+	{
+		return this->buffers[this->back];
+	}
+
+	void Publish()
+	{
+		this->back = this->middle.exchange(this->back | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+	// reader side: takes the latest published buffer, returning false and
+	// keeping the current one if nothing was published since the last call
+	bool Acquire()
+	{
+		if (!(this->middle.load(std::memory_order_acquire) & FRESH))
+			return false;
+
+		this->front = this->middle.exchange(this->front, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+
+	const T &GetReadBuffer() const
+	{
+		return this->buffers[this->front];
+	}
+};
@@ -0,0 +1,99 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+WorkerPool::WorkerPool(int threadCount)
+{
+	this->body = 0;
+	this->count = 0;
+	this->grain = 1;
+	this->nextChunk = 0;
+	this->generation = 0;
+	this->busyThreads = 0;
+	this->stopping = false;
+
+	for (int i = 1; i < threadCount; i++)
+		this->threads.push_back(thread(&WorkerPool::ThreadLoop, this));
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		lock_guard<mutex> lock(this->poolMutex);
+		this->stopping = true;
+	}
+	this->started.notify_all();
+
+	for (size_t i = 0; i < this->threads.size(); i++)
+		this->threads[i].join();
+}
+
+int WorkerPool::GetThreadCount() const
+{
+	return this->threads.size() + 1;
+}
+
+void WorkerPool::RunChunks()
+{
+	size_t chunks = (this->count + this->grain - 1) / this->grain;
+	for (size_t chunk = this->nextChunk++; chunk < chunks; chunk = this->nextChunk++)
+	{
+		size_t begin = chunk * this->grain;
+		(*this->body)(begin, min(begin + this->grain, this->count));
+	}
+}
+
+void WorkerPool::ThreadLoop()
+{
+	unsigned int seenGeneration = 0;
+	while (true)
+	{
+		{
+			unique_lock<mutex> lock(this->poolMutex);
+			while (this->generation == seenGeneration && !this->stopping)
+				this->started.wait(lock);
+			if (this->stopping)
+				return;
+			seenGeneration = this->generation;
+		}
+
+		RunChunks();
+
+		lock_guard<mutex> lock(this->poolMutex);
+		if (--this->busyThreads == 0)
+			this->finished.notify_one();
+	}
+}
+
+void WorkerPool::ParallelFor(size_t count, size_t grain, const function<void(size_t, size_t)> &body)
+{
+	if (count == 0)
+		return;
+
+	// not worth waking anyone for a single chunk
+	if (this->threads.empty() || count <= grain)
+	{
+		body(0, count);
+		return;
+	}
+
+	{
+		lock_guard<mutex> lock(this->poolMutex);
+		this->body = &body;
+		this->count = count;
+		this->grain = max<size_t>(grain, 1);
+		this->nextChunk = 0;
+		this->busyThreads = this->threads.size();
+		this->generation++;
+	}
+	this->started.notify_all();
+
+	RunChunks();
+
+	unique_lock<mutex> lock(this->poolMutex);
+	while (this->busyThreads > 0)
+		this->finished.wait(lock);
+	this->body = 0;
+}
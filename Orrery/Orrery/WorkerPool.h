@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// a fixed set of threads that split loops between them; the threads sleep
+// between loops instead of being created for each one
+class WorkerPool {
+private:
+	std::vector<std::thread> threads;
+	std::mutex poolMutex;
+	std::condition_variable started;
+	std::condition_variable finished;
+
+	// the loop being run: chunks of grain iterations are handed out in order
+	const std::function<void(size_t, size_t)> *body;
+	size_t count;
+	size_t grain;
+	std::atomic<size_t> nextChunk;
+
+	unsigned int generation;
+	int busyThreads;
+	bool stopping;
+
+	void ThreadLoop();
+	void RunChunks();
+
+	WorkerPool(const WorkerPool &);
+	WorkerPool &operator=(const WorkerPool &);
+
+public:
+	// threadCount includes the calling thread, which always takes part
+	WorkerPool(int threadCount);
+	~WorkerPool();
+
+	int GetThreadCount() const;
+
+	// calls body(begin, end) over [0, count) in chunks of at most grain
+	// iterations, on every thread at once, and returns when all have finished
+	void ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &body);
+};
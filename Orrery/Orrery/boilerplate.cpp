@@ -17,11 +17,25 @@
 #include <iterator>
 #include <vector>
 #include <algorithm>
+#include <thread>
 #include <math.h>
+#include <ctype.h>
+#include <cstddef>
 #include "glm\glm.hpp"
 #include "glm/gtc/type_ptr.hpp"
 #include "Camera.h"
 #include "structs.h"
+#include "RenderQueue.h"
+#include "TextureLoader.h"
+#include "OffscreenContext.h"
+#include "FrameExporter.h"
+#include "RenderTarget.h"
+#include "Gravity.h"
+#include "Scene.h"
+#include "Frustum.h"
+#include "Occlusion.h"
+#include "StarCatalog.h"
+#include "SphereMesh.h"
 #include "glcorearb.h"
 #include "soil/SOIL.h"
 
@@ -49,31 +63,159 @@ bool CheckGLErrors();
 
 string LoadSource(const string &filename);
 GLuint CompileShader(GLenum shaderType, const string &source);
-GLuint LinkProgram(GLuint vertexShader, GLuint fragmentShader);
+GLuint LinkProgram(GLuint vertexShader, GLuint fragmentShader, GLuint controlShader = 0, GLuint evaluationShader = 0);
 
 //global variables
 
-MyTexture earthTexture;
-MyTexture sunTexture;
-MyTexture moonTexture;
-MyTexture starTexture;
+MyTexture bodyTextures;
 MyShader shader;
-MyGeometry sphere;
+MyShader starShader;
+MyShader skyShader;
+MyShader impostorShader;
+MyShader proceduralShader;
+MyShader proceduralProxyShader;
+MyShader cubeSphereShader;
+MyInstanceBuffer instanceBuffer;
+
+// uniform buffer holding MyFrameConstants, bound to the binding point below
+GLuint frameConstantsBuffer = 0;
+const GLuint FRAME_CONSTANTS_BINDING = 0;
+
+// sphere meshes from coarsest to finest, each level doubling the edge counts
+const int SPHERE_LOD_COUNT = 5;
+const int SPHERE_LOD_LAT_EDGES[SPHERE_LOD_COUNT] = { 8, 16, 32, 64, 128 };
+MyGeometry sphereLods[SPHERE_LOD_COUNT];
+
+// the background stars, one point per catalog record in the catalog's
+// brightest first order
+MyGeometry starField;
+
+// the background when the scene shows a sky image instead of stars: a cube
+// map drawn by a single triangle with no vertex attributes
+MyTexture skyTexture;
+MyGeometry skyTriangle;
+
+// how bodies are drawn: as sphere meshes; as impostors, a square facing the
+// camera per body into which the fragment shader ray casts the sphere; or as
+// procedural spheres, the mesh levels made up in the vertex shader from
+// gl_VertexID so that none is built or stored; or as tessellated cube
+// spheres, a coarse cube the GPU refines to a steady size on screen
+enum BodyTechnique { BODIES_MESH, BODIES_IMPOSTOR, BODIES_PROCEDURAL, BODIES_TESSELLATED };
+BodyTechnique bodyTechnique = BODIES_MESH;
+MyGeometry impostorQuad;
+MyGeometry proceduralSphere;
+
+// patches of four corners in the tessellated cube sphere, 2 x 2 per face as
+// PATCHES_PER_EDGE in cubesphere_vertex.glsl has it
+const int CUBE_SPHERE_PATCHES = 6 * 2 * 2;
+MyGeometry cubeSphere;
+
+// faintest star drawn in an image 1080 pixels high; fainter ones would give
+// off less than about a pixel's worth of light
+const float STAR_MAGNITUDE_LIMIT = 6.5f;
+
+// largest distance in pixels a sphere's facets may deviate from the true surface
+const float LOD_PIXEL_ERROR = 1.0f;
+
+// bodies sharing a texture array and sphere level, drawn with one instanced call
+struct InstanceBatch
+{
+	MyTexture *texture;
+	int lod;
+	std::vector<MyInstance> instances;
+	
+	// offset of this batch's first record in the frame's instance buffer
+	GLint baseInstance;
+	
+	// the occlusion query deciding on the GPU whether the batch is drawn, 0
+	// for none; such batches hold a single body
+	GLuint conditionQuery;
+};
+
+// both are cleared, not freed, between frames so their storage is reused
+std::vector<InstanceBatch> batches;
+std::vector<MyInstance> frameInstances;
+
+RenderQueue renderQueue;
+
+// every body's and particle's bounding sphere, tested against the view
+// frustum before anything is submitted; reused from frame to frame
+Frustum frustum;
+BoundingSpheres boundingSpheres;
+std::vector<unsigned char> sphereVisible;
+
+// one occlusion query per body, each counting the samples of a stand-in
+// sphere drawn after the rest of the frame: a closed pole to pole sphere
+// made up in the vertex shader at the coarsest level's edge counts, since
+// the meshes only cover the lower hemisphere and the stand-in is neither
+// tilted nor spun like its body; it is enlarged past its facets, which sit
+// up to 4% inside the true surface, and a little further to cover a frame
+// of motion, so it encloses the whole globe however the body is turned
+OcclusionQueries occlusionQueries;
+std::vector<MyInstance> proxyInstances;
+std::vector<int> proxySlots;
+const float OCCLUSION_PROXY_SCALE = 1.1f;
 
 float timeScale = 100000.0f;
 float sizeScale = 10000000.0f;
 bool isRotating = false;
-float deltaTime = 0.0f;
 const float MOUSE_SENSITIVITY = 1.0f/100.0f;
 double oldXPos;
 double oldYPos;
 const string texturePath = "./SolarSystem/";
+const string textureCachePath = "./TextureCache/";
+const string defaultScene = "./scenes/solar_system.scene";
 const float WINDOW_WIDTH = 1024;
 const float WINDOW_HEIGHT = 1024;
 
+// height in pixels of the image being rendered, the window's or the exported frames'
+float viewportHeight = WINDOW_HEIGHT;
+
+// --headless renders a fixed number of frames offscreen and saves each one
+// to a file named by a printf style pattern
+struct HeadlessOptions
+{
+	bool enabled;
+	int width, height;
+	int frames;
+	float framesPerSecond;
+	string outputPattern;
+};
+
+// --scene picks the bodies to show; --gravity adds a disc of particles
+// around the central star that move under their mutual gravity, alongside
+// the bodies on prescribed orbits; --ephemeris takes those bodies from a
+// precomputed file, fitting it first if needed
+struct SimulationOptions
+{
+	string sceneFile;
+	int particles;
+	string ephemerisFile;
+};
+
+// --bodies picks how the bodies are drawn
+struct RenderOptions
+{
+	BodyTechnique bodies;
+};
+
+const float PARTICLE_RADIUS = 0.05f;
+
 bool isPaused = false;
 
-Camera camera(45.0f, WINDOW_WIDTH / WINDOW_HEIGHT, 0.1f, 100000.0f);
+// real seconds between simulation ticks, whatever the frame rate
+const double SIMULATION_TICK = 1.0 / 120.0;
+
+// an ephemeris covers this many simulated seconds either side of the epoch,
+// a century
+const double EPHEMERIS_SPAN = 100 * 8766.15 * 3600.0;
+
+// texel bytes streamed into textures per frame while they are still loading
+const size_t TEXTURE_UPLOAD_BUDGET = 4 * 1024 * 1024;
+
+unsigned int frameGLCalls = 0;
+
+Camera camera(45.0f, WINDOW_WIDTH / WINDOW_HEIGHT, 0.1f);
 
 float ChangeRadiusScale(float radius)
 {
@@ -84,48 +226,72 @@ float ChangeRadiusScale(float radius)
 float ChangeDistanceScale(float distance, float scale, float offset)
 {
 	float d = distance / scale + offset;
+	return d;
 }
 
 
 
 
-bool InitializeTexture(MyTexture *texture, const string &imageFileName)
+// creates a texture buffer object through which the vertex shader fetches
+// per-instance data
+bool InitializeInstanceBuffer(MyInstanceBuffer *instances)
 {
-	int w, h;
-	unsigned char *pixels = SOIL_load_image((texturePath+imageFileName).c_str(), &w, &h, 0, SOIL_LOAD_RGB);
-
-	// SOIL_load_image will return NULL if it fails
-	if (!pixels) {
-		return false;
-	}
-
-    // store the image width and height into the texture structure
-    texture->width = w;
-    texture->height = h;
-
-    // create a texture name to associate our image data with
-    if (!texture->textureName)
-        glGenTextures(1, &texture->textureName);
-
-    // bind the texture as a "rectangle" to access using image pixel coordinates
-    glBindTexture(GL_TEXTURE_2D, texture->textureName);
+	glGenBuffers(1, &instances->buffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, instances->buffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(MyInstance), 0, GL_STREAM_DRAW);
+	instances->capacity = 1;
+	
+	glGenTextures(1, &instances->texture);
+	glBindTexture(GL_TEXTURE_BUFFER, instances->texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, instances->buffer);
+	
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	
+	return !CheckGLErrors();
+}
 
-    // send image pixel data to OpenGL texture memory
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, texture->width, texture->height,
-                 0, GL_RGB, GL_UNSIGNED_BYTE, pixels);
-                 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glGenerateMipmap(GL_TEXTURE_2D);
+void DestroyInstanceBuffer(MyInstanceBuffer *instances)
+{
+	glDeleteTextures(1, &instances->texture);
+	glDeleteBuffers(1, &instances->buffer);
+}
 
-    // unbind this texture
-    glBindTexture(GL_TEXTURE_2D, 0);
+// creates the uniform buffer for MyFrameConstants and attaches it to its
+// binding point, where it stays for the life of the program
+bool InitializeFrameConstants(GLuint *buffer)
+{
+	glGenBuffers(1, buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, *buffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(MyFrameConstants), 0, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_CONSTANTS_BINDING, *buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	
+	return !CheckGLErrors();
+}
 
-	SOIL_free_image_data(pixels);
+// the faintest stars worth drawing at the current image height, each
+// doubling of it showing stars half as bright again
+float StarMagnitudeLimit()
+{
+	return STAR_MAGNITUDE_LIMIT + 2.5f * log10(viewportHeight / 1080.0f);
+}
 
-    return !CheckGLErrors();
+// writes this frame's camera matrices, light position and time in one upload
+void UpdateFrameConstants(GLuint buffer, float time)
+{
+	MyFrameConstants constants;
+	constants.projectionMatrix = camera.GetProjectionMatrix();
+	constants.viewMatrix = camera.GetViewMatrix();
+	constants.lightPosition = constants.viewMatrix * glm::vec4(0, 0, 0, 1);
+	constants.time = time;
+	constants.viewportHeight = viewportHeight;
+	constants.starMagnitudeLimit = StarMagnitudeLimit();
+	constants.nearPlane = camera.GetNear();
+	
+	COUNT_GL(glBindBuffer(GL_UNIFORM_BUFFER, buffer));
+	COUNT_GL(glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(MyFrameConstants), &constants));
+	COUNT_GL(glBindBuffer(GL_UNIFORM_BUFFER, 0));
 }
 
 // --------------------------------------------------------------------------
@@ -133,8 +299,10 @@ bool InitializeTexture(MyTexture *texture, const string &imageFileName)
 
 
 
-// load, compile, and link shaders, returning true if successful
-bool InitializeShaders(MyShader *shader, string vertexShader, string fragmentShader)
+// load, compile, and link shaders, returning true if successful; the
+// tessellation stages are left out when their file names are empty
+bool InitializeShaders(MyShader *shader, string vertexShader, string fragmentShader,
+                       string controlShader = "", string evaluationShader = "")
 {
     // load shader source from files
     string vertexSource = LoadSource(vertexShader);
@@ -144,9 +312,35 @@ bool InitializeShaders(MyShader *shader, string vertexShader, string fragmentSha
     // compile shader source into shader objects
     shader->vertex = CompileShader(GL_VERTEX_SHADER, vertexSource);
     shader->fragment = CompileShader(GL_FRAGMENT_SHADER, fragmentSource);
+    if (!controlShader.empty() || !evaluationShader.empty())
+    {
+        string controlSource = LoadSource(controlShader);
+        string evaluationSource = LoadSource(evaluationShader);
+        if (controlSource.empty() || evaluationSource.empty()) return false;
+
+        shader->control = CompileShader(GL_TESS_CONTROL_SHADER, controlSource);
+        shader->evaluation = CompileShader(GL_TESS_EVALUATION_SHADER, evaluationSource);
+    }
 
     // link shader program
-    shader->program = LinkProgram(shader->vertex, shader->fragment);
+    shader->program = LinkProgram(shader->vertex, shader->fragment, shader->control, shader->evaluation);
+
+    // every program reads the per-frame values from the same uniform buffer
+    GLuint frameConstantsIndex = glGetUniformBlockIndex(shader->program, "FrameConstants");
+    if (frameConstantsIndex != GL_INVALID_INDEX)
+        glUniformBlockBinding(shader->program, frameConstantsIndex, FRAME_CONSTANTS_BINDING);
+
+    // look up uniform locations once so rendering never queries them by name
+    shader->texturesLocation = glGetUniformLocation(shader->program, "textures");
+    shader->instancesLocation = glGetUniformLocation(shader->program, "instances");
+    shader->baseInstanceLocation = glGetUniformLocation(shader->program, "baseInstance");
+    shader->sphereEdgesLocation = glGetUniformLocation(shader->program, "sphereEdges");
+
+    // samplers always read the same texture units, so set them here too
+    glUseProgram(shader->program);
+    glUniform1i(shader->texturesLocation, 0);
+    glUniform1i(shader->instancesLocation, 1);
+    glUseProgram(0);
 
     // check for OpenGL errors and return false if error occurred
     return !CheckGLErrors();
@@ -160,6 +354,8 @@ void DestroyShader(MyShader *shader)
     glDeleteProgram(shader->program);
     glDeleteShader(shader->vertex);
     glDeleteShader(shader->fragment);
+    glDeleteShader(shader->control);
+    glDeleteShader(shader->evaluation);
 }
 
 // --------------------------------------------------------------------------
@@ -169,67 +365,15 @@ void DestroyShader(MyShader *shader)
 
 bool InitializeSphere(MyGeometry *geometry, int latEdges, int longEdges)
 {
-	std::vector<GLfloat> vertices;
-	std::vector<GLfloat> vertexCoords;
-	
-	float dTheta = (2 * 3.1415926535) / longEdges;
-	float dPhi = 3.1415926535 / latEdges;
-	
-	for (int i = 0; i < latEdges; i++)
-	{
-		// angles in radians of latitude points on sphere
-		float p1 = 3.1415926535*2 - ((i + 1) * dPhi);
-		float p2 = p1 + dPhi;
-		
-		// v texture coords for points on sphere
-		float v1 = 1 - (p1 + 3.1415926535*2) / 3.1415926535;
-		float v2 = 1 - (p2 + 3.1415926535*2) / 3.1415926535;
-		
-		for (int j = 0; j < longEdges; j++)
-		{
-			// angles in radians of longitude points on sphere
-			float t1 = j * dTheta;
-			float t2 = t1 + dTheta;
-			
-			// u texture coords for points on sphere
-			float u1 = t1 / (2 * 3.1415926535);
-			float u2 = t2 / (2 * 3.1415926535);
-			
-			float x1 = cos(p1) * sin(t1);
-			float z1 = cos(p1) * cos(t1);
-			float y1 = sin(p1);
-			
-			float x2 = cos(p2) * sin(t1);
-			float z2 = cos(p2) * cos(t1);
-			float y2 = sin(p2);
-			
-			float x3 = cos(p2) * sin(t2);
-			float z3 = cos(p2) * cos(t2);
-			float y3 = sin(p2);
-			
-			float x4 = cos(p1) * sin(t2);
-			float z4 = cos(p1) * cos(t2);
-			float y4 = sin(p1);
-			
-			// add first triangle
-			vertices.push_back(x1); vertices.push_back(y1); vertices.push_back(z1);
-			vertices.push_back(x2); vertices.push_back(y2); vertices.push_back(z2); 
-			vertices.push_back(x4); vertices.push_back(y4); vertices.push_back(z4);
-			vertexCoords.push_back(u1); vertexCoords.push_back(v1);
-			vertexCoords.push_back(u1); vertexCoords.push_back(v2);
-			vertexCoords.push_back(u2); vertexCoords.push_back(v1);
-			
-			// add second triangle
-			vertices.push_back(x4); vertices.push_back(y4); vertices.push_back(z4);
-			vertices.push_back(x2); vertices.push_back(y2); vertices.push_back(z2);
-			vertices.push_back(x3); vertices.push_back(y3); vertices.push_back(z3);
-			vertexCoords.push_back(u2); vertexCoords.push_back(v1);
-			vertexCoords.push_back(u1); vertexCoords.push_back(v2);
-			vertexCoords.push_back(u2); vertexCoords.push_back(v2);
-		}
-	}
+	std::vector<MyVertex> vertices;
+	std::vector<GLushort> indices;
+	if (!BuildSphereMesh(latEdges, longEdges, &vertices, &indices))
+		return false;
 	
-	geometry->elementCount = vertices.size()/3;
+	geometry->vertexStride = sizeof(MyVertex);
+	geometry->vertexCount = vertices.size();
+	geometry->elementCount = indices.size();
+	geometry->indexType = GL_UNSIGNED_SHORT;
 
     // these vertex attribute indices correspond to those specified for the
     // input variables in the vertex shader
@@ -237,58 +381,94 @@ bool InitializeSphere(MyGeometry *geometry, int latEdges, int longEdges)
     const GLuint VERTEX_COORDS_INDEX = 1;
     const GLuint VERTEX_NORMAL_INDEX = 2;
 
-    //-----------
-    // add texture index
-    //-----------
-
-    // create an array buffer object for storing our vertices
+    // create an array buffer object for storing our interleaved vertices
     glGenBuffers(1, &geometry->vertexBuffer);
     glBindBuffer(GL_ARRAY_BUFFER, geometry->vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), &vertices[0], GL_STATIC_DRAW);
-
-    // create another one for storing our vertexcoords
-    glGenBuffers(1, &geometry->textureCoordBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, geometry->textureCoordBuffer);
-    glBufferData(GL_ARRAY_BUFFER, vertexCoords.size() * sizeof(GLfloat), &vertexCoords[0], GL_STATIC_DRAW);
-    
-    glGenBuffers(1, &geometry->normalBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, geometry->normalBuffer);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), &vertices[0], GL_STATIC_DRAW);
-    //-------------------------
-    // generate bind and buffer texture coordinate data
-    //-------------------------
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(MyVertex), &vertices[0], GL_STATIC_DRAW);
 
     // create a vertex array object encapsulating all our vertex attributes
     glGenVertexArrays(1, &geometry->vertexArray);
     glBindVertexArray(geometry->vertexArray);
 
-    // associate the position array with the vertex array object
+    // the element array binding is part of the vertex array object state
+    glGenBuffers(1, &geometry->indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry->indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), &indices[0], GL_STATIC_DRAW);
+
+    // associate the interleaved attributes with the vertex array object
     glBindBuffer(GL_ARRAY_BUFFER, geometry->vertexBuffer);
-    glVertexAttribPointer(VERTEX_INDEX, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glVertexAttribPointer(VERTEX_INDEX, 3, GL_FLOAT, GL_FALSE, geometry->vertexStride,
+                          (const GLvoid *)offsetof(MyVertex, position));
     glEnableVertexAttribArray(VERTEX_INDEX);
     
-    glBindBuffer(GL_ARRAY_BUFFER, geometry->normalBuffer);
-    glVertexAttribPointer(VERTEX_NORMAL_INDEX, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glVertexAttribPointer(VERTEX_NORMAL_INDEX, 3, GL_FLOAT, GL_FALSE, geometry->vertexStride,
+                          (const GLvoid *)offsetof(MyVertex, normal));
     glEnableVertexAttribArray(VERTEX_NORMAL_INDEX);
 
-	glBindBuffer(GL_ARRAY_BUFFER, geometry->textureCoordBuffer);
-    glVertexAttribPointer(VERTEX_COORDS_INDEX, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    glVertexAttribPointer(VERTEX_COORDS_INDEX, 2, GL_FLOAT, GL_FALSE, geometry->vertexStride,
+                          (const GLvoid *)offsetof(MyVertex, textureCoord));
     glEnableVertexAttribArray(VERTEX_COORDS_INDEX);
 
-    // assocaite the colour array with the vertex array object
-    
-    //-----------------
-    // Set up vertex attribute info for textures
-    //-----------------
-
     // unbind our buffers, resetting to default state
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
     // check for OpenGL errors and return false if error occurred
     return !CheckGLErrors();
 }
 
+// uploads a star catalog's records as they are, one vertex per star
+bool InitializeStarField(MyGeometry *geometry, const StarCatalog &catalog)
+{
+	geometry->vertexStride = sizeof(StarRecord);
+	geometry->vertexCount = catalog.GetCount();
+	geometry->elementCount = 0;
+	geometry->indexType = GL_NONE;
+	
+	// these vertex attribute indices correspond to those specified for the
+	// input variables in the star vertex shader
+	const GLuint DIRECTION_INDEX = 0;
+	const GLuint MAGNITUDE_INDEX = 1;
+	const GLuint COLOUR_INDEX_INDEX = 2;
+	
+	glGenBuffers(1, &geometry->vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, geometry->vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, catalog.GetCount() * sizeof(StarRecord), catalog.GetStars(), GL_STATIC_DRAW);
+	
+	glGenVertexArrays(1, &geometry->vertexArray);
+	glBindVertexArray(geometry->vertexArray);
+	
+	glVertexAttribPointer(DIRECTION_INDEX, 3, GL_FLOAT, GL_FALSE, geometry->vertexStride,
+	                      (const GLvoid *)offsetof(StarRecord, direction));
+	glEnableVertexAttribArray(DIRECTION_INDEX);
+	
+	glVertexAttribPointer(MAGNITUDE_INDEX, 1, GL_FLOAT, GL_FALSE, geometry->vertexStride,
+	                      (const GLvoid *)offsetof(StarRecord, magnitude));
+	glEnableVertexAttribArray(MAGNITUDE_INDEX);
+	
+	glVertexAttribPointer(COLOUR_INDEX_INDEX, 1, GL_FLOAT, GL_FALSE, geometry->vertexStride,
+	                      (const GLvoid *)offsetof(StarRecord, colourIndex));
+	glEnableVertexAttribArray(COLOUR_INDEX_INDEX);
+	
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	
+	return !CheckGLErrors();
+}
+
+// a vertex array with nothing in it, for draws whose vertex shader makes
+// up its vertices from gl_VertexID, which core profiles still need one for
+bool InitializeAttributelessGeometry(MyGeometry *geometry, int vertexCount)
+{
+	geometry->vertexCount = vertexCount;
+	geometry->elementCount = 0;
+	geometry->indexType = GL_NONE;
+	glGenVertexArrays(1, &geometry->vertexArray);
+	
+	return !CheckGLErrors();
+}
+
 // deallocate geometry-related objects
 void DestroyGeometry(MyGeometry *geometry)
 {
@@ -296,8 +476,7 @@ void DestroyGeometry(MyGeometry *geometry)
     glBindVertexArray(0);
     glDeleteVertexArrays(1, &geometry->vertexArray);
     glDeleteBuffers(1, &geometry->vertexBuffer);
-    glDeleteBuffers(1, &geometry->textureCoordBuffer);
-    glDeleteBuffers(1, &geometry->normalBuffer);
+    glDeleteBuffers(1, &geometry->indexBuffer);
 }
 
 
@@ -308,64 +487,334 @@ void DestroyTextures(MyTexture *texture)
 
 
 
+// whether glClipControl is there, core since OpenGL 4.5 and an extension before
+bool HasClipControl()
+{
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	if (major > 4 || (major == 4 && minor >= 5))
+		return true;
+	
+	GLint extensions = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+	for (GLint i = 0; i < extensions; i++)
+	{
+		if (string((const char *)glGetStringi(GL_EXTENSIONS, i)) == "GL_ARB_clip_control")
+			return true;
+	}
+	return false;
+}
+
 void InitGL()
 {
+	// reversed depth: the camera puts the near plane at depth 1 and infinity
+	// at 0, so nearer is greater and the buffer clears to infinity. Without
+	// clip control clip depth still runs from -1 and depths far away are
+	// rounded when it is mapped into 0 to 1
 	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LEQUAL);
-	glClearColor(1.0, 0.0, 0.0, 1.0);
+	glDepthFunc(GL_GEQUAL);
+	glClearDepth(0.0);
+	bool zeroToOneDepth = HasClipControl();
+	if (zeroToOneDepth)
+		glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+	camera.SetZeroToOneDepth(zeroToOneDepth);
+	glClearColor(0.0, 0.0, 0.0, 1.0);
+	glEnable(GL_PROGRAM_POINT_SIZE);
+	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+	glPatchParameteri(GL_PATCH_VERTICES, 4);
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 }
 
 // --------------------------------------------------------------------------
-// Rendering function that draws our scene to the frame buffer
+// Level of detail selection for the sphere meshes
 
-void RenderScene(Planet *planet, MyShader *shader, glm::mat4 P, bool isStar)
+// picks the coarsest sphere level whose facets stay within LOD_PIXEL_ERROR
+// of the true surface, given the body's centre in view space
+int SelectSphereLod(float radius, glm::vec3 viewCentre)
 {
+	// focal length in pixels of the camera's vertical field of view
 	glm::mat4 projectionMatrix = camera.GetProjectionMatrix();
-	glm::mat4 viewMatrix = camera.GetViewMatrix();
+	float focalLength = fabs(projectionMatrix[1][1]) * viewportHeight / 2;
 	
-	glm::mat4 Rl = planet->localRotationMatrix;
-	glm::mat4 Ro = planet->orbitalRotationMatrix;
-	glm::mat4 IRo = glm::transpose(planet->orbitalRotationMatrix);
-	glm::mat4 A = planet->axialTiltMatrix;
-	glm::mat4 T = planet->translationMatrix;
-	glm::mat4 S = planet->scaleMatrix;
+	// distance from the camera to the nearest point of the surface, which
+	// also covers a camera sitting inside the sphere
+	float surfaceDistance = fabs(glm::length(viewCentre) - radius);
+	surfaceDistance = max(surfaceDistance, camera.GetNear());
 	
-	glm::mat4 modelMatrix = P * Ro * T * S * A * IRo * Rl;
+	for (int lod = 0; lod < SPHERE_LOD_COUNT; lod++)
+	{
+		// a facet spanning angle dPhi sags radius * (1 - cos(dPhi / 2)) below the sphere
+		float dPhi = 3.1415926535 / SPHERE_LOD_LAT_EDGES[lod];
+		float sagitta = radius * (1 - cos(dPhi / 2));
+		
+		if (sagitta * focalLength / surfaceDistance <= LOD_PIXEL_ERROR)
+			return lod;
+	}
 	
-    // clear screen to a dark grey colour
-    
-    // bind our shader program and the vertex array object containing our
-    // scene geometry, then tell OpenGL to draw our geometry
-    glUseProgram(shader->program);
-    GLint projectionMatrixLocation = glGetUniformLocation(shader->program, "projectionMatrix");
-	glUniformMatrix4fv(projectionMatrixLocation, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+	return SPHERE_LOD_COUNT - 1;
+}
+
+// --------------------------------------------------------------------------
+// Rendering functions that draw our scene to the frame buffer
+
+// adds an instance to the batch drawing its texture array at a sphere level,
+// or to a batch of its own if it is drawn under an occlusion query
+void SubmitInstance(MyTexture *texture, int lod, const MyInstance &instance, GLuint conditionQuery)
+{
+	// batches keep their first-submitted order so the draw order is stable
+	for (size_t i = 0; i < batches.size() && !conditionQuery; i++)
+	{
+		if (batches[i].texture == texture && batches[i].lod == lod && !batches[i].conditionQuery)
+		{
+			batches[i].instances.push_back(instance);
+			return;
+		}
+	}
 	
-	GLint viewMatrixLocation = glGetUniformLocation(shader->program, "viewMatrix");
-	glUniformMatrix4fv(viewMatrixLocation, 1, GL_FALSE, glm::value_ptr(viewMatrix));
+	InstanceBatch batch;
+	batch.texture = texture;
+	batch.lod = lod;
+	batch.conditionQuery = conditionQuery;
+	batch.instances.push_back(instance);
+	batches.push_back(batch);
+}
+
+// queues a body for this frame's instanced draws, at its node's world matrix
+void SubmitPlanet(const SceneGraph &scene, Planet *planet, bool isStar, GLuint conditionQuery)
+{
+	glm::mat4 viewMatrix = camera.GetViewMatrix();
 	
-	GLint modelMatrixLocation = glGetUniformLocation(shader->program, "modelMatrix");
-	glUniformMatrix4fv(modelMatrixLocation, 1, GL_FALSE, glm::value_ptr(modelMatrix));
+	MyInstance instance;
+	instance.modelMatrix = scene.GetWorldMatrix(planet->sceneNode);
+	instance.parameters = glm::vec4(planet->textureLayer, isStar ? 1 : 0, 0, 0);
 	
-	GLint texLocation = glGetUniformLocation(shader->program, "texture");
-	glUniform1i(texLocation, 0);
+	// impostors and tessellated spheres look after their own detail, so
+	// every body shares one batch per texture
+	if (bodyTechnique == BODIES_MESH || bodyTechnique == BODIES_PROCEDURAL)
+		planet->lod = SelectSphereLod(planet->radius, glm::vec3(viewMatrix * instance.modelMatrix[3]));
+	else
+		planet->lod = 0;
+	SubmitInstance(planet->texture, planet->lod, instance, conditionQuery);
+}
+
+// queues the stand-in sphere whose samples an occlusion query slot counts
+void SubmitOcclusionProxy(glm::vec3 centre, float radius, int slot)
+{
+	MyInstance instance;
+	instance.modelMatrix = glm::translate(glm::mat4(), centre) * glm::scale(glm::mat4(), glm::vec3(radius));
+	instance.parameters = glm::vec4(0);
 	
-	GLint starLocation = glGetUniformLocation(shader->program, "isStar");
-	glUniform1i(starLocation, isStar);
+	proxyInstances.push_back(instance);
+	proxySlots.push_back(slot);
+}
+
+// queues one gravity particle, an unlit sphere with no spin or tilt
+void SubmitParticle(glm::vec3 position, MyTexture *texture, int layer)
+{
+	MyInstance instance;
+	instance.modelMatrix = glm::translate(glm::mat4(), position) * glm::scale(glm::mat4(), glm::vec3(PARTICLE_RADIUS));
+	instance.parameters = glm::vec4(layer, 0, 0, 0);
 	
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, planet->texture->textureName);
+	int lod = 0;
+	if (bodyTechnique == BODIES_MESH || bodyTechnique == BODIES_PROCEDURAL)
+		lod = SelectSphereLod(PARTICLE_RADIUS, glm::vec3(camera.GetViewMatrix() * glm::vec4(position, 1)));
+	SubmitInstance(texture, lod, instance, 0);
+}
 
-    glBindVertexArray(sphere.vertexArray);
+// a thin disc of light particles on near circular orbits between two radii
+// around a body of mass 1 at the origin, the simulation's G being its GM
+void AddParticleDisc(GravitySimulation *gravity, int particles, double innerRadius, double outerRadius)
+{
+	const double DISC_MASS = 1e-4;
+	const double DISC_THICKNESS = 0.2;
+	double GM = gravity->GetGravitationalConstant();
+	
+	srand(1);
+	for (int i = 0; i < particles; i++)
+	{
+		double r = innerRadius + (outerRadius - innerRadius) * rand() / RAND_MAX;
+		double angle = 2 * 3.14159265358979 * rand() / RAND_MAX;
+		double height = DISC_THICKNESS * ((double)rand() / RAND_MAX - 0.5);
+		
+		// a percent or so of scatter in speed keeps the disc from ringing
+		double speed = sqrt(GM / r) * (1 + 0.02 * ((double)rand() / RAND_MAX - 0.5));
+		
+		// the scene turns counterclockwise seen from +y, like Keplerian orbits
+		glm::dvec3 position(r * cos(angle), height, -r * sin(angle));
+		glm::dvec3 velocity(-speed * sin(angle), 0, -speed * cos(angle));
+		gravity->AddBody(position, velocity, DISC_MASS / particles);
+	}
+}
 
-    glDrawArrays(GL_TRIANGLES, 0, sphere.elementCount);
+// queues the stars at least as bright as a magnitude, which lead the
+// catalog, as sprites on the far plane; like the sky they are drawn after
+// the bodies, so the depth test rejects whatever a body covers before it
+// is shaded
+void SubmitStars(const StarCatalog &catalog, float magnitudeLimit)
+{
+	DrawItem item;
+	item.pass = 1;
+	item.program = starShader.program;
+	item.vertexArray = starField.vertexArray;
+	item.mode = GL_POINTS;
+	item.count = catalog.CountBrighterThan(magnitudeLimit);
+	item.indexType = GL_NONE;
+	if (item.count > 0)
+		renderQueue.Submit(item);
+}
 
-    // reset state to default (no shader or geometry bound)
-    glBindVertexArray(0);
-    glUseProgram(0);
+// queues the sky's cube map across the whole screen, on the far plane and
+// after the bodies
+void SubmitSky()
+{
+	DrawItem item;
+	item.pass = 1;
+	item.program = skyShader.program;
+	item.vertexArray = skyTriangle.vertexArray;
+	item.textureTargets[0] = GL_TEXTURE_CUBE_MAP;
+	item.textures[0] = skyTexture.textureName;
+	item.count = skyTriangle.vertexCount;
+	item.indexType = GL_NONE;
+	renderQueue.Submit(item);
+}
 
-    // check for an report any OpenGL errors
-    CheckGLErrors();
+// vertices in a procedural sphere at the given level, two triangles per quad
+GLsizei ProceduralSphereVertexCount(int lod)
+{
+	return SPHERE_LOD_LAT_EDGES[lod] * 2 * SPHERE_LOD_LAT_EDGES[lod] * 6;
+}
+
+// draws every occlusion stand-in against the depth the frame left behind,
+// each inside its slot's query, touching neither colour nor depth
+void DrawOcclusionProxies(GLint baseInstance)
+{
+	if (proxyInstances.empty())
+		return;
+	
+	// every technique draws at least what a closed sphere covers, which the
+	// lower hemisphere meshes cannot stand in for, so the stand-in is made
+	// up in the vertex shader however the bodies are drawn
+	COUNT_GL(glUseProgram(proceduralProxyShader.program));
+	COUNT_GL(glBindVertexArray(proceduralSphere.vertexArray));
+	COUNT_GL(glUniform2i(proceduralProxyShader.sphereEdgesLocation, SPHERE_LOD_LAT_EDGES[0], 2 * SPHERE_LOD_LAT_EDGES[0]));
+	COUNT_GL(glActiveTexture(GL_TEXTURE1));
+	COUNT_GL(glBindTexture(GL_TEXTURE_BUFFER, instanceBuffer.texture));
+	COUNT_GL(glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE));
+	COUNT_GL(glDepthMask(GL_FALSE));
+	
+	for (size_t i = 0; i < proxyInstances.size(); i++)
+	{
+		occlusionQueries.Begin(proxySlots[i]);
+		COUNT_GL(glUniform1i(proceduralProxyShader.baseInstanceLocation, baseInstance + i));
+		COUNT_GL(glDrawArraysInstanced(GL_TRIANGLES, 0, ProceduralSphereVertexCount(0), 1));
+		occlusionQueries.End();
+	}
+	
+	COUNT_GL(glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE));
+	COUNT_GL(glDepthMask(GL_TRUE));
+	renderQueue.Invalidate();
+	
+	proxyInstances.clear();
+	proxySlots.clear();
+}
+
+// queues one instanced draw per batch of submitted bodies and flushes the
+// queue, then draws the occlusion stand-ins, leaving the batches and
+// stand-ins empty for the next frame
+void RenderScene(MyShader *shader)
+{
+	// gather all instances into one upload, remembering where each batch
+	// starts; the stand-ins follow the batches
+	frameInstances.clear();
+	for (size_t i = 0; i < batches.size(); i++)
+	{
+		batches[i].baseInstance = frameInstances.size();
+		frameInstances.insert(frameInstances.end(), batches[i].instances.begin(), batches[i].instances.end());
+	}
+	GLint proxyBaseInstance = frameInstances.size();
+	frameInstances.insert(frameInstances.end(), proxyInstances.begin(), proxyInstances.end());
+	
+	// orphan and refill the instance buffer, growing it if needed; with no
+	// bodies in view only the stars are drawn
+	if (!frameInstances.empty())
+	{
+		COUNT_GL(glBindBuffer(GL_TEXTURE_BUFFER, instanceBuffer.buffer));
+		if ((GLsizei)frameInstances.size() > instanceBuffer.capacity)
+			instanceBuffer.capacity = frameInstances.size();
+		COUNT_GL(glBufferData(GL_TEXTURE_BUFFER, instanceBuffer.capacity * sizeof(MyInstance), 0, GL_STREAM_DRAW));
+		COUNT_GL(glBufferSubData(GL_TEXTURE_BUFFER, 0, frameInstances.size() * sizeof(MyInstance), &frameInstances[0]));
+		COUNT_GL(glBindBuffer(GL_TEXTURE_BUFFER, 0));
+	}
+	
+	// camera matrices come from the frame constants and the sampler units
+	// were fixed when the program was linked, so each batch is a plain draw
+	for (size_t i = 0; i < batches.size(); i++)
+	{
+		if (batches[i].instances.empty())
+			continue;
+		
+		DrawItem item;
+		item.program = shader->program;
+		item.textureTargets[0] = GL_TEXTURE_2D_ARRAY;
+		item.textures[0] = batches[i].texture->textureName;
+		item.textureTargets[1] = GL_TEXTURE_BUFFER;
+		item.textures[1] = instanceBuffer.texture;
+		if (bodyTechnique == BODIES_IMPOSTOR)
+		{
+			// four corners per body, made up by the vertex shader
+			item.vertexArray = impostorQuad.vertexArray;
+			item.mode = GL_TRIANGLE_STRIP;
+			item.count = impostorQuad.vertexCount;
+			item.indexType = GL_NONE;
+		}
+		else if (bodyTechnique == BODIES_TESSELLATED)
+		{
+			// the control shader decides how far each patch is refined
+			item.vertexArray = cubeSphere.vertexArray;
+			item.mode = GL_PATCHES;
+			item.count = cubeSphere.vertexCount;
+			item.indexType = GL_NONE;
+		}
+		else if (bodyTechnique == BODIES_PROCEDURAL)
+		{
+			// the level only sets how many vertices the shader makes up
+			int lod = batches[i].lod;
+			item.vertexArray = proceduralSphere.vertexArray;
+			item.count = ProceduralSphereVertexCount(lod);
+			item.indexType = GL_NONE;
+			item.sphereEdgesLocation = shader->sphereEdgesLocation;
+			item.sphereEdges[0] = SPHERE_LOD_LAT_EDGES[lod];
+			item.sphereEdges[1] = 2 * SPHERE_LOD_LAT_EDGES[lod];
+		}
+		else
+		{
+			MyGeometry *sphere = &sphereLods[batches[i].lod];
+			item.vertexArray = sphere->vertexArray;
+			item.count = sphere->elementCount;
+			item.indexType = sphere->indexType;
+		}
+		item.instanceCount = batches[i].instances.size();
+		item.baseInstanceLocation = shader->baseInstanceLocation;
+		item.baseInstance = batches[i].baseInstance;
+		item.conditionQuery = batches[i].conditionQuery;
+		renderQueue.Submit(item);
+		
+		batches[i].instances.clear();
+	}
+	
+	// a batch under a query holds this frame's body only, the next frame's
+	// may not be in it
+	size_t kept = 0;
+	for (size_t i = 0; i < batches.size(); i++)
+	{
+		if (!batches[i].conditionQuery)
+			batches[kept++] = batches[i];
+	}
+	batches.resize(kept);
+	
+	renderQueue.Flush();
+	DrawOcclusionProxies(proxyBaseInstance);
 }
 
 // --------------------------------------------------------------------------
@@ -436,42 +885,178 @@ void ScrollCallback(GLFWwindow* window, double xoffset, double yoffset)
 
 
 
+// --------------------------------------------------------------------------
+// Command line
+
+// whether a frame name pattern is safe to hand to snprintf with one int:
+// exactly one %d or %0Nd, and every other % written as %%
+bool IsFramePattern(const string &pattern)
+{
+	int conversions = 0;
+	for (size_t i = 0; i < pattern.size(); i++)
+	{
+		if (pattern[i] != '%')
+			continue;
+		if (++i < pattern.size() && pattern[i] == '%')
+			continue;
+		
+		// a width, if any, has to be zero padded and at most two digits
+		if (i < pattern.size() && pattern[i] == '0')
+		{
+			size_t digits = 0;
+			while (++i < pattern.size() && isdigit((unsigned char)pattern[i]))
+				digits++;
+			if (digits < 1 || digits > 2)
+				return false;
+		}
+		if (i >= pattern.size() || pattern[i] != 'd')
+			return false;
+		conversions++;
+	}
+	return conversions == 1;
+}
+
+// reads the command line, returning false if it is malformed
+bool ParseOptions(int argc, char *argv[], HeadlessOptions *headless, SimulationOptions *simulation, RenderOptions *render)
+{
+	render->bodies = BODIES_MESH;
+
+	simulation->sceneFile = defaultScene;
+	simulation->particles = 0;
+	simulation->ephemerisFile = "";
+
+	headless->enabled = false;
+	headless->width = 1920;
+	headless->height = 1080;
+	headless->frames = 240;
+	headless->framesPerSecond = 30.0f;
+	headless->outputPattern = "frame_%04d.png";
+	
+	for (int i = 1; i < argc; i++)
+	{
+		string option = argv[i];
+		bool hasValue = i + 1 < argc;
+		
+		if (option == "--headless")
+			headless->enabled = true;
+		else if (option == "--size" && hasValue)
+		{
+			if (sscanf(argv[++i], "%dx%d", &headless->width, &headless->height) != 2 ||
+			    headless->width <= 0 || headless->height <= 0)
+				return false;
+		}
+		else if (option == "--frames" && hasValue)
+			headless->frames = atoi(argv[++i]);
+		else if (option == "--fps" && hasValue)
+			headless->framesPerSecond = atof(argv[++i]);
+		else if (option == "--output" && hasValue)
+		{
+			headless->outputPattern = argv[++i];
+			if (!IsFramePattern(headless->outputPattern))
+			{
+				cout << "ERROR: --output " << headless->outputPattern << " needs exactly one %d or %0Nd for the frame number, "
+				     << "and any other % written as %%" << endl;
+				return false;
+			}
+		}
+		else if (option == "--scene" && hasValue)
+			simulation->sceneFile = argv[++i];
+		else if (option == "--gravity" && hasValue)
+		{
+			simulation->particles = atoi(argv[++i]);
+			if (simulation->particles < 0)
+				return false;
+		}
+		else if (option == "--ephemeris" && hasValue)
+			simulation->ephemerisFile = argv[++i];
+		else if (option == "--bodies" && hasValue)
+		{
+			string technique = argv[++i];
+			if (technique == "mesh")
+				render->bodies = BODIES_MESH;
+			else if (technique == "impostor")
+				render->bodies = BODIES_IMPOSTOR;
+			else if (technique == "procedural")
+				render->bodies = BODIES_PROCEDURAL;
+			else if (technique == "tessellated")
+				render->bodies = BODIES_TESSELLATED;
+			else
+				return false;
+		}
+		else
+			return false;
+	}
+	
+	return headless->frames >= 0 && headless->framesPerSecond > 0;
+}
+
+// the name of an exported frame, from a pattern such as frame_%04d.png that
+// IsFramePattern has accepted
+string FrameFileName(const string &pattern, int frame)
+{
+	char fileName[1024];
+	snprintf(fileName, sizeof(fileName), pattern.c_str(), frame);
+	return fileName;
+}
+
 // ==========================================================================
 // PROGRAM ENTRY POINT
 
 int main(int argc, char *argv[])
 {
-    // initialize the GLFW windowing system
-    if (!glfwInit()) {
-        cout << "ERROR: GLFW failed to initilize, TERMINATING" << endl;
+    HeadlessOptions headless;
+    SimulationOptions simulationOptions;
+    RenderOptions renderOptions;
+    if (!ParseOptions(argc, argv, &headless, &simulationOptions, &renderOptions))
+    {
+        cout << "usage: " << argv[0] << " [--headless [--size WIDTHxHEIGHT] [--frames N] [--fps N] [--output frame_%04d.png]] [--scene FILE] [--gravity PARTICLES] [--ephemeris FILE] [--bodies mesh|impostor|procedural|tessellated]" << endl;
         return -1;
     }
-    glfwSetErrorCallback(ErrorCallback);
-
-    // attempt to create a window with an OpenGL 4.1 core profile context
-    GLFWwindow *window = 0;
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "Chris's Awesome Orrery", 0, 0);
+    bodyTechnique = renderOptions.bodies;
     
-    if (!window) {
-        cout << "Program failed to create GLFW window, TERMINATING" << endl;
-        glfwTerminate();
-        return -1;
+    GLFWwindow *window = 0;
+    OffscreenContext offscreenContext;
+    if (headless.enabled)
+    {
+        // no window at all, frames are drawn into a framebuffer object
+        if (!offscreenContext.Create())
+        {
+            cout << "Program failed to create an offscreen OpenGL context, TERMINATING" << endl;
+            return -1;
+        }
     }
+    else
+    {
+        // initialize the GLFW windowing system
+        if (!glfwInit()) {
+            cout << "ERROR: GLFW failed to initilize, TERMINATING" << endl;
+            return -1;
+        }
+        glfwSetErrorCallback(ErrorCallback);
+
+        // attempt to create a window with an OpenGL 4.1 core profile context
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "Chris's Awesome Orrery", 0, 0);
+        
+        if (!window) {
+            cout << "Program failed to create GLFW window, TERMINATING" << endl;
+            glfwTerminate();
+            return -1;
+        }
 
-    // set keyboard callback function and make our context current (active)
-    glfwSetKeyCallback(window, KeyCallback);
-	glfwSetCursorPosCallback(window, CursorCallback);
-	glfwSetMouseButtonCallback(window, MouseButtonCallback);
-	glfwSetScrollCallback(window, ScrollCallback);
-    glfwMakeContextCurrent(window);
+        // set keyboard callback function and make our context current (active)
+        glfwSetKeyCallback(window, KeyCallback);
+        glfwSetCursorPosCallback(window, CursorCallback);
+        glfwSetMouseButtonCallback(window, MouseButtonCallback);
+        glfwSetScrollCallback(window, ScrollCallback);
+        glfwMakeContextCurrent(window);
+    }
 
     // query and print out information about our OpenGL environment
     QueryGLVersion();
-    InitGL();
 #ifdef _WIN32
 	// Intialize GLEW
 	glewExperimental = GL_TRUE;
@@ -482,73 +1067,421 @@ int main(int argc, char *argv[])
 	//RendererUtility::
 	CheckGLErrors();
 #endif
-    InitializeSphere(&sphere, 40, 80);
+    // after GLEW, which supplies the newer entry points on Windows
+    InitGL();
+    for (int lod = 0; lod < SPHERE_LOD_COUNT && bodyTechnique != BODIES_PROCEDURAL; lod++)
+	{
+		if (!InitializeSphere(&sphereLods[lod], SPHERE_LOD_LAT_EDGES[lod], 2 * SPHERE_LOD_LAT_EDGES[lod]))
+		{
+			cout << "Program could not initialize geometry, TERMINATING" << endl;
+			return -1;
+		}
+	}
+	if (!InitializeAttributelessGeometry(&impostorQuad, 4) || !InitializeAttributelessGeometry(&proceduralSphere, 0) ||
+	    !InitializeAttributelessGeometry(&cubeSphere, 4 * CUBE_SPHERE_PATCHES))
+	{
+		cout << "Program could not initialize geometry, TERMINATING" << endl;
+		return -1;
+	}
 
     // call function to load and compile shader programs
     
-    if (!InitializeShaders(&shader, "vertex.glsl", "fragment.glsl"))
+    if (!InitializeShaders(&shader, "vertex.glsl", "fragment.glsl") ||
+        !InitializeShaders(&starShader, "star_vertex.glsl", "star_fragment.glsl") ||
+        !InitializeShaders(&skyShader, "sky_vertex.glsl", "sky_fragment.glsl") ||
+        !InitializeShaders(&impostorShader, "impostor_vertex.glsl", "impostor_fragment.glsl") ||
+        !InitializeShaders(&proceduralShader, "procedural_vertex.glsl", "fragment.glsl") ||
+        !InitializeShaders(&proceduralProxyShader, "procedural_vertex.glsl", "proxy_fragment.glsl") ||
+        !InitializeShaders(&cubeSphereShader, "cubesphere_vertex.glsl", "cubesphere_fragment.glsl",
+                           "cubesphere_control.glsl", "cubesphere_evaluation.glsl"))
 	{
         cout << "Program could not initialize shaders, TERMINATING" << endl;
         return -1;
     }
-
-    // load and initialize the texture
-    if(!InitializeTexture(&earthTexture, "texture_earth_surface.jpg") ||
-		!InitializeTexture(&sunTexture, "texture_sun.jpg") ||
-		!InitializeTexture(&moonTexture, "texture_moon.jpg")||
-		!InitializeTexture(&starTexture, "strx.png"))
-		
+    MyShader *bodyShader = &shader;
+    if (bodyTechnique == BODIES_IMPOSTOR)
+        bodyShader = &impostorShader;
+    else if (bodyTechnique == BODIES_PROCEDURAL)
+        bodyShader = &proceduralShader;
+    else if (bodyTechnique == BODIES_TESSELLATED)
+        bodyShader = &cubeSphereShader;
+
+    // bodies and the textures they use come from the scene's compiled form,
+    // which is read in place
+    Scene sceneFile;
+    if (!LoadScene(simulationOptions.sceneFile, &sceneFile))
+	{
+        cout << "Program could not load scene " << simulationOptions.sceneFile << ", TERMINATING" << endl;
+        return -1;
+	}
+    
+    // load and initialize the textures, all body textures sharing one array
+    vector<string> bodyTextureNames(sceneFile.GetTextureCount());
+    for (size_t i = 0; i < bodyTextureNames.size(); i++)
+		bodyTextureNames[i] = texturePath + sceneFile.GetTextureName(i);
+    
+    // images are decoded in the background, so the first frames are drawn
+    // with placeholders until the textures stream in
+    TextureLoader textureLoader(max(1u, thread::hardware_concurrency()), textureCachePath);
+    if(!textureLoader.Load(&bodyTextures, bodyTextureNames))
 	{
         cout << "Failed to load textures!" << endl;
 		return -1;
 	}
 	
-	Planet stars(10000.0f, 0.0f, 0.0f, 0.0f, 0.0f, &starTexture);
-	Planet sun(ChangeRadiusScale(695500.0f), 0.0f, 600.0f, 0.0f, 7.25f, &sunTexture);
-	Planet earth(ChangeRadiusScale(6371.0f), ChangeDistanceScale(149600000.0f, sizeScale, 0), 24.0f, 8760.0f, 23.4f, &earthTexture);
-	Planet moon(ChangeRadiusScale(1737.0f), ChangeDistanceScale(385000.0f, sizeScale, 4 * earth.radius), 648.0f, 648.0f, 6.687f, &moonTexture);
+	// the background stars are found in the scene's sky map once and kept
+	// in a catalog beside it, which is all that reaches the GPU; a sky shown
+	// as it is comes from the cube map it was baked to
+	StarCatalog starCatalog;
+	if (sceneFile.GetStarImage())
+	{
+		string starImage = texturePath + sceneFile.GetStarImage();
+		if (!LoadStarCatalog(starImage, &starCatalog) || !InitializeStarField(&starField, starCatalog))
+		{
+			cout << "Program could not load the stars in " << starImage << ", TERMINATING" << endl;
+			return -1;
+		}
+	}
+	if (sceneFile.GetSkyImage())
+	{
+		string skyFile = DDSCubeMapFileName(texturePath + sceneFile.GetSkyImage());
+		if (!InitializeAttributelessGeometry(&skyTriangle, 3))
+		{
+			cout << "Program could not initialize geometry, TERMINATING" << endl;
+			return -1;
+		}
+		if (!LoadCubeMap(&skyTexture, skyFile))
+		{
+			// a half made cube map is dropped, so the sky is not drawn with it
+			cout << "ERROR: Could not load " << skyFile << ", bake it with texbake --cubemap" << endl;
+			DestroyTextures(&skyTexture);
+			skyTexture.textureName = 0;
+		}
+	}
+	
+	if (!InitializeInstanceBuffer(&instanceBuffer) || !InitializeFrameConstants(&frameConstantsBuffer))
+	{
+		cout << "Program could not initialize render buffers, TERMINATING" << endl;
+		return -1;
+	}
+	
+	// every body's orbit lives in one table that is propagated as a batch, and
+	// its transforms in a scene graph node below its parent's
+	vector<Planet> planets;
+	planets.reserve(sceneFile.GetBodyCount());
+	BodyTable bodies;
+	SceneGraph scene;
+	for (int i = 0; i < sceneFile.GetBodyCount(); i++)
+	{
+		const SceneBody &body = sceneFile.GetBody(i);
+		const Planet *parent = (body.parent >= 0) ? &planets[body.parent] : 0;
+		
+		OrbitalElements orbit;
+		if (body.orbitalPeriod > 0)
+		{
+			float clearance = parent ? body.orbitClearance * parent->radius : 0.0f;
+			orbit.semiMajorAxis = ChangeDistanceScale(body.semiMajorAxis, sizeScale, clearance);
+			orbit.eccentricity = body.eccentricity;
+			orbit.inclination = glm::radians(body.inclination);
+			orbit.ascendingNode = glm::radians(body.ascendingNode);
+			orbit.argumentOfPeriapsis = glm::radians(body.argumentOfPeriapsis);
+			orbit.meanAnomalyAtEpoch = glm::radians(body.meanAnomalyAtEpoch);
+			orbit.period = body.orbitalPeriod * 3600.0;
+		}
+		
+		planets.push_back(Planet(ChangeRadiusScale(body.radius), orbit, body.dayLength, body.axialTilt,
+		                         &bodyTextures, body.textureLayer));
+		planets[i].bodyIndex = bodies.Add(planets[i].orbit.GetElements(), planets[i].localPeriod);
+		planets[i].AddToScene(&scene, parent);
+	}
+	
+	// the particle disc circles the scene's particle body's parent, whose GM
+	// follows from Kepler's third law for that body's orbit; the disc's
+	// units are those where the parent has mass 1
+	int centralBody = -1, particleLayer = sceneFile.GetParticleLayer();
+	double centralGM = 0;
+	if (sceneFile.GetParticleBody() >= 0)
+	{
+		double a = planets[sceneFile.GetParticleBody()].orbit.GetElements().semiMajorAxis;
+		double T = planets[sceneFile.GetParticleBody()].orbit.GetElements().period;
+		centralBody = sceneFile.GetBody(sceneFile.GetParticleBody()).parent;
+		centralGM = 4 * 3.14159265358979 * 3.14159265358979 * a * a * a / (T * T);
+	}
+	else if (simulationOptions.particles > 0)
+		cout << "ERROR: " << simulationOptions.sceneFile << " has no particles line, --gravity is ignored" << endl;
+	
+	WorkerPool workers(max(1u, thread::hardware_concurrency()));
+	GravitySimulation gravity(centralGM, 0.05, 0.5, &workers);
+	if (simulationOptions.particles > 0 && centralBody >= 0)
+	{
+		gravity.AddBody(glm::dvec3(0), glm::dvec3(0), 1.0);
+		AddParticleDisc(&gravity, simulationOptions.particles, 4.0, 24.0);
+	}
+	
+	if (!occlusionQueries.Initialize(planets.size()))
+	{
+		cout << "Program could not initialize occlusion queries, TERMINATING" << endl;
+		return -1;
+	}
+	
+	// results arrive a frame late, which a bright body coming out from
+	// behind a planet shows as a frame's delay; exported frames are far
+	// apart in time, so they draw everything the frustum lets through
+	bool occlusionCulling = !headless.enabled;
 	
-	glfwSetTime(0);
-	double lastTime = glfwGetTime();
+	// fitted to the same orbits as the body table, one body per row
+	Ephemeris ephemeris;
+	if (!simulationOptions.ephemerisFile.empty())
+	{
+		vector<EphemerisSource> sources(planets.size());
+		for (size_t i = 0; i < planets.size(); i++)
+		{
+			sources[i].orbit = planets[i].orbit.GetElements();
+			sources[i].spinPeriod = planets[i].localPeriod;
+		}
+		
+		const string &filename = simulationOptions.ephemerisFile;
+		unsigned long long sourceHash = HashEphemerisSources(sources);
+		if (!ephemeris.Open(filename, sourceHash))
+		{
+			cout << "Fitting ephemeris " << filename << endl;
+			if (!BuildEphemeris(filename, sources, -EPHEMERIS_SPAN, EPHEMERIS_SPAN, &workers) ||
+			    !ephemeris.Open(filename, sourceHash))
+				cout << "ERROR: Could not build ephemeris " << filename << ", using the orbits directly" << endl;
+		}
+	}
+	
+	// bodies and particles advance in fixed ticks on their own thread, or on
+	// this one for exported frames, which must not depend on how long a frame
+	// takes; the renderer draws what it interpolates between the latest two
+	Simulation simulation(&bodies, &gravity, SIMULATION_TICK);
+	SimulationSnapshot frameState;
+	if (ephemeris.IsOpen())
+		simulation.SetEphemeris(&ephemeris);
+	
+	FrameExporter frameExporter;
+	if (headless.enabled)
+	{
+		// every exported frame should show the real textures, not placeholders
+		textureLoader.Finish();
+		
+		camera.SetAspect((float)headless.width / headless.height);
+		viewportHeight = headless.height;
+		if (!frameExporter.Initialize(headless.width, headless.height))
+		{
+			cout << "Program could not initialize frame export, TERMINATING" << endl;
+			return -1;
+		}
+		frameExporter.Bind();
+	}
+	
+	// the window's framebuffer has no floating point depth, so frames are
+	// drawn into a target that has and copied across before each swap
+	RenderTarget windowTarget;
+	if (!headless.enabled)
+	{
+		int framebufferWidth, framebufferHeight;
+		glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+		if (!windowTarget.Initialize(framebufferWidth, framebufferHeight))
+		{
+			cout << "Program could not initialize its render target, TERMINATING" << endl;
+			return -1;
+		}
+		windowTarget.Bind();
+	}
+	
+	if (!headless.enabled)
+	{
+		glfwSetTime(0);
+		simulation.Start();
+	}
+	int frame = 0;
+	
+	// frames and OpenGL calls since the window title was last updated
+	double lastReportTime = 0;
+	unsigned int reportFrames = 0;
+	unsigned int reportGLCalls = 0;
+	unsigned int reportStateChanges = 0;
 
     // run an event-triggered main loop
-    while (!glfwWindowShouldClose(window))
+    while (headless.enabled ? frame < headless.frames : !glfwWindowShouldClose(window))
     {
-		double currTime = glfwGetTime();
-		deltaTime = currTime - lastTime;
-		lastTime = currTime;
+		// exported animations advance a fixed step per frame, however long it takes to draw
+		double currTime = headless.enabled ? frame / headless.framesPerSecond : glfwGetTime();
 		
-		float updateDelta = deltaTime * timeScale;
+		frameGLCalls = 0;
 		
-		if (!isPaused)
+		// the window's target, projection and star sizes follow its
+		// framebuffer, which is empty while the window is minimized
+		if (!headless.enabled)
 		{
-			sun.Update(updateDelta);
-			earth.Update(updateDelta);
-			moon.Update(updateDelta);
+			int framebufferWidth, framebufferHeight;
+			glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+			if (framebufferWidth > 0 && framebufferHeight > 0)
+			{
+				if (!windowTarget.Resize(framebufferWidth, framebufferHeight))
+				{
+					cout << "ERROR: Could not resize the render target to " << framebufferWidth << "x" << framebufferHeight << endl;
+					break;
+				}
+				camera.SetAspect((float)framebufferWidth / framebufferHeight);
+				viewportHeight = framebufferHeight;
+			}
 		}
 		
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		// textures that finished loading replace their placeholders, which
+		// the render queue's record of bound state does not know about
+		if (textureLoader.Update(TEXTURE_UPLOAD_BUDGET))
+			renderQueue.Invalidate();
 		
-		RenderScene(&stars, &shader, glm::mat4(), true);
-		RenderScene(&sun, &shader, glm::mat4(), true);
+		simulation.SetTimeScale(timeScale);
+		simulation.SetPaused(isPaused);
+		if (headless.enabled)
+		{
+			simulation.AdvanceTo(currTime);
+			simulation.Interpolate(currTime, &frameState);
+		}
+		else
+			simulation.Interpolate(simulation.Now(), &frameState);
+		
+		for (size_t i = 0; i < planets.size(); i++)
+			planets[i].Update(frameState, &scene);
+		scene.Update();
+		
+		COUNT_GL(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+		
+		UpdateFrameConstants(frameConstantsBuffer, currTime);
+		
+		// particles are drawn around the rendered central body, whichever way
+		// the simulated one drifts
+		glm::vec3 particleCentre = (centralBody >= 0) ? scene.GetWorldPosition(planets[centralBody].sceneNode) : glm::vec3(0);
+		
+		// bodies first, then particles, all culled in one pass
+		frustum.Extract(camera.GetProjectionMatrix() * camera.GetViewMatrix());
+		boundingSpheres.Clear();
+		for (size_t i = 0; i < planets.size(); i++)
+			boundingSpheres.Add(scene.GetWorldPosition(planets[i].sceneNode), planets[i].radius);
+		for (size_t i = 0; i < frameState.particlePositions.size(); i++)
+			boundingSpheres.Add(frameState.particlePositions[i] + particleCentre, PARTICLE_RADIUS);
+		frustum.CullSpheres(boundingSpheres, &sphereVisible);
+		
+		// self-lit bodies are always drawn; the rest are skipped when last
+		// frame's query found them hidden, drawn under the query when its
+		// result has not arrived, and queried again for the next frame
+		glm::mat4 viewMatrix = camera.GetViewMatrix();
+		occlusionQueries.Collect();
+		
+		if (starCatalog.IsOpen())
+			SubmitStars(starCatalog, StarMagnitudeLimit());
+		if (skyTexture.textureName)
+			SubmitSky();
+		for (size_t i = 0; i < planets.size(); i++)
+		{
+			bool isStar = (sceneFile.GetBody(i).flags & SCENE_BODY_EMISSIVE) != 0;
+			glm::vec3 centre = scene.GetWorldPosition(planets[i].sceneNode);
+			float proxyRadius = planets[i].radius * OCCLUSION_PROXY_SCALE;
+			
+			// a camera inside the stand-in would see none of it
+			bool queried = occlusionCulling && !isStar && sphereVisible[i] &&
+			               glm::length(glm::vec3(viewMatrix * glm::vec4(centre, 1))) > proxyRadius + camera.GetNear();
+			if (!queried)
+			{
+				occlusionQueries.Forget(i);
+				if (sphereVisible[i])
+					SubmitPlanet(scene, &planets[i], isStar, 0);
+				continue;
+			}
+			
+			GLuint pendingQuery = occlusionQueries.GetPendingQuery(i);
+			if (pendingQuery || !occlusionQueries.IsHidden(i))
+				SubmitPlanet(scene, &planets[i], isStar, pendingQuery);
+			SubmitOcclusionProxy(centre, proxyRadius, i);
+		}
+		for (size_t i = 0; i < frameState.particlePositions.size(); i++)
+		{
+			if (sphereVisible[planets.size() + i])
+				SubmitParticle(frameState.particlePositions[i] + particleCentre, &bodyTextures, particleLayer);
+		}
 		
         // call function to draw our scene
-        RenderScene(&earth, &shader, glm::mat4(), false);
-        
-        RenderScene(&moon, &shader, earth.globalTransform, false);
-
-        // scene is rendered to the back buffer, so swap to front for display
-        glfwSwapBuffers(window);
+        RenderScene(bodyShader);
+
+        reportFrames++;
+        reportGLCalls += frameGLCalls;
+        reportStateChanges += renderQueue.TakeStateChanges();
+        if (currTime - lastReportTime >= 1.0)
+        {
+			string title = "Chris's Awesome Orrery - " + to_string(reportFrames) + " fps, "
+			             + to_string(reportGLCalls / reportFrames) + " GL calls and "
+			             + to_string(reportStateChanges / reportFrames) + " state changes per frame";
+			if (window)
+				glfwSetWindowTitle(window, title.c_str());
+			
+			lastReportTime = currTime;
+			reportFrames = 0;
+			reportGLCalls = 0;
+			reportStateChanges = 0;
+        }
 
-        glfwPollEvents();
+        if (headless.enabled)
+        {
+			if (!frameExporter.Capture(FrameFileName(headless.outputPattern, frame)))
+				break;
+        }
+        else
+        {
+			// scene is rendered to the window's target, copied to the back
+			// buffer and swapped to front for display
+			int framebufferWidth, framebufferHeight;
+			glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+			windowTarget.BlitToWindow(framebufferWidth, framebufferHeight);
+			glfwSwapBuffers(window);
+
+			glfwPollEvents();
+        }
+        frame++;
     }
+    
+    if (headless.enabled)
+    {
+		frameExporter.Finish();
+		frameExporter.Destroy();
+		cout << "Wrote " << frame << " frames" << endl;
+    }
+    else
+		windowTarget.Destroy();
 
+    simulation.Stop();
+    
     // clean up allocated resources before exit
-    DestroyGeometry(&sphere);
+    for (int lod = 0; lod < SPHERE_LOD_COUNT; lod++)
+		DestroyGeometry(&sphereLods[lod]);
+    textureLoader.Shutdown();
+    DestroyInstanceBuffer(&instanceBuffer);
+    glDeleteBuffers(1, &frameConstantsBuffer);
+    DestroyTextures(&bodyTextures);
+    DestroyGeometry(&starField);
+    DestroyGeometry(&skyTriangle);
+    DestroyGeometry(&impostorQuad);
+    DestroyGeometry(&proceduralSphere);
+    DestroyGeometry(&cubeSphere);
+    DestroyTextures(&skyTexture);
+    occlusionQueries.Destroy();
+    DestroyShader(&shader);
+    DestroyShader(&starShader);
+    DestroyShader(&skyShader);
+    DestroyShader(&impostorShader);
+    DestroyShader(&proceduralShader);
+    DestroyShader(&proceduralProxyShader);
+    DestroyShader(&cubeSphereShader);
    
 	
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    if (window)
+    {
+		glfwDestroyWindow(window);
+		glfwTerminate();
+    }
+    offscreenContext.Destroy();
 
     cout << "Goodbye!" << endl;
     return 0;
@@ -575,7 +1508,7 @@ void QueryGLVersion()
 bool CheckGLErrors()
 {
     bool error = false;
-    for (GLenum flag = glGetError(); flag != GL_NO_ERROR; flag = glGetError())
+    for (GLenum flag = COUNT_GL(glGetError()); flag != GL_NO_ERROR; flag = COUNT_GL(glGetError()))
     {
         cout << "OpenGL ERROR:  ";
         switch (flag) {
@@ -649,7 +1582,7 @@ GLuint CompileShader(GLenum shaderType, const string &source)
 }
 
 // creates and returns a program object linked from vertex and fragment shaders
-GLuint LinkProgram(GLuint vertexShader, GLuint fragmentShader)
+GLuint LinkProgram(GLuint vertexShader, GLuint fragmentShader, GLuint controlShader, GLuint evaluationShader)
 {
     // allocate program object name
     GLuint programObject = glCreateProgram();
@@ -657,6 +1590,8 @@ GLuint LinkProgram(GLuint vertexShader, GLuint fragmentShader)
     // attach provided shader objects to this program
     if (vertexShader)   glAttachShader(programObject, vertexShader);
     if (fragmentShader) glAttachShader(programObject, fragmentShader);
+    if (controlShader)  glAttachShader(programObject, controlShader);
+    if (evaluationShader) glAttachShader(programObject, evaluationShader);
 
     // try linking the program with given attachments
     glLinkProgram(programObject);
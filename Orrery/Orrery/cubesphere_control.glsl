@@ -0,0 +1,76 @@
+// ==========================================================================
+// Tessellation control program for bodies drawn as tessellated cube spheres,
+// refining each edge until its triangles span about the same pixels on screen
+// ==========================================================================
+#version 410
+
+layout(vertices = 4) out;
+
+// values shared by every draw in a frame, see MyFrameConstants in structs.h
+layout(std140) uniform FrameConstants
+{
+	mat4 projectionMatrix;
+	mat4 viewMatrix;
+	vec4 lightPosition;
+	float time;
+	float viewportHeight;
+	float starMagnitudeLimit;
+	float nearPlane;
+};
+
+// per-instance records, five texels each: the model matrix columns followed
+// by (texture layer, is star, 0, 0), see MyInstance in structs.h
+uniform samplerBuffer instances;
+
+// edge length on screen each triangle is refined to, in pixels
+const float EDGE_PIXELS = 8.0;
+
+// the largest level every implementation supports
+const float MAX_LEVEL = 64.0;
+
+in vec3 cubePosition[];
+flat in int instanceRecord[];
+
+out vec3 patchPosition[];
+flat out int patchRecord[];
+
+// the level an edge between two corners on the unit sphere needs: the
+// screen size of the sphere around the edge, which stays sensible for
+// edges beside or behind the camera
+float EdgeLevel(mat4 modelView, vec3 a, vec3 b)
+{
+	vec3 centre = vec3(modelView * vec4((a + b) * 0.5, 1.0));
+	float diameter = length(mat3(modelView) * (a - b));
+	float distance = max(length(centre), 1e-6);
+	float pixels = diameter * projectionMatrix[1][1] * viewportHeight * 0.5 / distance;
+	return clamp(pixels / EDGE_PIXELS, 1.0, MAX_LEVEL);
+}
+
+void main()
+{
+	patchPosition[gl_InvocationID] = cubePosition[gl_InvocationID];
+	patchRecord[gl_InvocationID] = instanceRecord[gl_InvocationID];
+
+	if (gl_InvocationID == 0)
+	{
+		int record = instanceRecord[0];
+		mat4 modelMatrix = mat4(texelFetch(instances, record),
+		                        texelFetch(instances, record + 1),
+		                        texelFetch(instances, record + 2),
+		                        texelFetch(instances, record + 3));
+		mat4 modelView = viewMatrix * modelMatrix;
+
+		vec3 p0 = normalize(cubePosition[0]);
+		vec3 p1 = normalize(cubePosition[1]);
+		vec3 p2 = normalize(cubePosition[2]);
+		vec3 p3 = normalize(cubePosition[3]);
+
+		// outer levels run along u = 0, v = 0, u = 1 and v = 1
+		gl_TessLevelOuter[0] = EdgeLevel(modelView, p3, p0);
+		gl_TessLevelOuter[1] = EdgeLevel(modelView, p0, p1);
+		gl_TessLevelOuter[2] = EdgeLevel(modelView, p1, p2);
+		gl_TessLevelOuter[3] = EdgeLevel(modelView, p2, p3);
+		gl_TessLevelInner[0] = max(gl_TessLevelOuter[1], gl_TessLevelOuter[3]);
+		gl_TessLevelInner[1] = max(gl_TessLevelOuter[0], gl_TessLevelOuter[2]);
+	}
+}
@@ -0,0 +1,57 @@
+// ==========================================================================
+// Tessellation evaluation program for bodies drawn as tessellated cube
+// spheres, pushing each generated point on the cube out onto the sphere
+// ==========================================================================
+#version 410
+
+layout(quads, fractional_odd_spacing, ccw) in;
+
+// values shared by every draw in a frame, see MyFrameConstants in structs.h
+layout(std140) uniform FrameConstants
+{
+	mat4 projectionMatrix;
+	mat4 viewMatrix;
+	vec4 lightPosition;
+	float time;
+	float viewportHeight;
+	float starMagnitudeLimit;
+	float nearPlane;
+};
+
+// per-instance records, five texels each: the model matrix columns followed
+// by (texture layer, is star, 0, 0), see MyInstance in structs.h
+uniform samplerBuffer instances;
+
+in vec3 patchPosition[];
+flat in int patchRecord[];
+
+// output to be interpolated between vertices and passed to the fragment stage
+out vec3 bodyNormal;
+out vec3 vertexNormal;
+out vec3 viewPosition;
+flat out float textureLayer;
+flat out int isStar;
+
+void main()
+{
+	int record = patchRecord[0];
+	mat4 modelMatrix = mat4(texelFetch(instances, record),
+	                        texelFetch(instances, record + 1),
+	                        texelFetch(instances, record + 2),
+	                        texelFetch(instances, record + 3));
+	vec4 parameters = texelFetch(instances, record + 4);
+
+	vec3 bottom = mix(patchPosition[0], patchPosition[1], gl_TessCoord.x);
+	vec3 top = mix(patchPosition[3], patchPosition[2], gl_TessCoord.x);
+	vec3 position = normalize(mix(bottom, top, gl_TessCoord.y));
+
+	vec4 N = viewMatrix * modelMatrix * vec4(position, 0.0);
+	vec4 P = viewMatrix * modelMatrix * vec4(position, 1.0);
+	gl_Position = projectionMatrix * P;
+
+	bodyNormal = position;
+	vertexNormal = vec3(N);
+	viewPosition = vec3(P);
+	textureLayer = parameters.x;
+	isStar = int(parameters.y);
+}
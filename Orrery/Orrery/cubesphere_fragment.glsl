@@ -0,0 +1,55 @@
+// ==========================================================================
+// Fragment program for bodies drawn as tessellated cube spheres, mapping the
+// equirectangular texture per pixel since cube faces do not follow its rows
+// ==========================================================================
+#version 410
+
+// values shared by every draw in a frame, see MyFrameConstants in structs.h
+layout(std140) uniform FrameConstants
+{
+	mat4 projectionMatrix;
+	mat4 viewMatrix;
+	vec4 lightPosition;
+	float time;
+	float viewportHeight;
+	float starMagnitudeLimit;
+	float nearPlane;
+};
+
+uniform sampler2DArray textures;
+
+in vec3 bodyNormal;
+in vec3 vertexNormal;
+in vec3 viewPosition;
+flat in float textureLayer;
+flat in int isStar;
+
+// first output is mapped to the framebuffer's colour index by default
+out vec4 FragmentColour;
+
+const float PI = 3.1415926535;
+
+void main(void)
+{
+	// longitude from the body's z axis towards x, latitude towards y, as
+	// equirectangular textures are laid out with north on the top row
+	vec3 n = normalize(bodyNormal);
+	float u = fract(atan(n.x, n.z) / (2.0 * PI));
+	float v = 0.5 - asin(clamp(n.y, -1.0, 1.0)) / PI;
+
+	// u jumps from 1 to 0 at the seam; measured from the opposite meridian
+	// it does not, and whichever changes less picks the mip level
+	float seamU = fract(u + 0.5) - 0.5;
+	vec2 dx = vec2(abs(dFdx(u)) < abs(dFdx(seamU)) ? dFdx(u) : dFdx(seamU), dFdx(v));
+	vec2 dy = vec2(abs(dFdy(u)) < abs(dFdy(seamU)) ? dFdy(u) : dFdy(seamU), dFdy(v));
+	vec3 C = textureGrad(textures, vec3(u, v, textureLayer), dx, dy).rgb;
+
+	if (isStar == 0)
+	{
+		vec3 N = normalize(vertexNormal);
+		vec3 L = normalize(lightPosition.xyz - viewPosition);
+		C = C * max(0, dot(L, N));
+	}
+
+	FragmentColour = vec4(C, 1);
+}
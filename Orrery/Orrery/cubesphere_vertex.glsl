@@ -0,0 +1,58 @@
+// ==========================================================================
+// Vertex program for bodies drawn as tessellated cube spheres: the corners
+// of the coarse cube the tessellation stages refine, made up from
+// gl_VertexID with no vertex attributes
+// ==========================================================================
+#version 410
+
+// values shared by every draw in a frame, see MyFrameConstants in structs.h
+layout(std140) uniform FrameConstants
+{
+	mat4 projectionMatrix;
+	mat4 viewMatrix;
+	vec4 lightPosition;
+	float time;
+	float viewportHeight;
+	float starMagnitudeLimit;
+	float nearPlane;
+};
+
+// per-instance records, five texels each: the model matrix columns followed
+// by (texture layer, is star, 0, 0), see MyInstance in structs.h
+uniform samplerBuffer instances;
+uniform int baseInstance;
+
+// each cube face is split into PATCHES_PER_EDGE x PATCHES_PER_EDGE patches
+// of four corners, enough that the largest refinement stays fine when close
+const int PATCHES_PER_EDGE = 2;
+
+// face axes as (normal, u direction, v direction), wound counterclockwise
+// seen from outside
+const ivec3 FACE_NORMALS[6] = ivec3[6](ivec3(1, 0, 0), ivec3(-1, 0, 0), ivec3(0, 1, 0),
+                                       ivec3(0, -1, 0), ivec3(0, 0, 1), ivec3(0, 0, -1));
+const ivec3 FACE_U[6] = ivec3[6](ivec3(0, 0, -1), ivec3(0, 0, 1), ivec3(1, 0, 0),
+                                 ivec3(1, 0, 0), ivec3(1, 0, 0), ivec3(-1, 0, 0));
+const ivec3 FACE_V[6] = ivec3[6](ivec3(0, 1, 0), ivec3(0, 1, 0), ivec3(0, 0, -1),
+                                 ivec3(0, 0, 1), ivec3(0, 1, 0), ivec3(0, 1, 0));
+
+// corners of a patch in the order the quad domain expects them
+const ivec2 PATCH_CORNERS[4] = ivec2[4](ivec2(0, 0), ivec2(1, 0), ivec2(1, 1), ivec2(0, 1));
+
+// corner on the cube from -1 to 1, and the record it is drawn with
+out vec3 cubePosition;
+flat out int instanceRecord;
+
+void main()
+{
+	int patchIndex = gl_VertexID / 4;
+	int face = patchIndex / (PATCHES_PER_EDGE * PATCHES_PER_EDGE);
+	int cell = patchIndex % (PATCHES_PER_EDGE * PATCHES_PER_EDGE);
+	ivec2 corner = ivec2(cell % PATCHES_PER_EDGE, cell / PATCHES_PER_EDGE) + PATCH_CORNERS[gl_VertexID % 4];
+
+	// integer steps, so corners shared between patches come out identical
+	// and so do the edge levels worked out from them
+	ivec2 grid = corner * 2 - PATCHES_PER_EDGE;
+	cubePosition = (vec3(FACE_NORMALS[face] * PATCHES_PER_EDGE) + vec3(FACE_U[face] * grid.x) +
+	                vec3(FACE_V[face] * grid.y)) / float(PATCHES_PER_EDGE);
+	instanceRecord = (baseInstance + gl_InstanceID) * 5;
+}
@@ -7,14 +7,25 @@
 // ==========================================================================
 #version 410
 
-uniform sampler2D texture;
+// values shared by every draw in a frame, see MyFrameConstants in structs.h
+layout(std140) uniform FrameConstants
+{
+	mat4 projectionMatrix;
+	mat4 viewMatrix;
+	vec4 lightPosition;
+	float time;
+	float viewportHeight;
+	float starMagnitudeLimit;
+	float nearPlane;
+};
 
-uniform bool isStar;
+uniform sampler2DArray textures;
 
 // interpolated colour received from vertex stage
-in vec2 textureCoord;
+in vec3 textureCoord;
 in vec3 vertexNormal;
-in vec3 lightVector;
+in vec3 viewPosition;
+flat in int isStar;
 
 // first output is mapped to the framebuffer's colour index by default
 out vec4 FragmentColour;
@@ -22,12 +33,12 @@ out vec4 FragmentColour;
 void main(void)
 {
 	vec3 N = normalize(vertexNormal);
-	vec3 L = normalize(lightVector);
+	vec3 L = normalize(lightPosition.xyz - viewPosition);
 	
-	vec3 texColour = vec3(texture2D(texture, textureCoord));
+	vec3 texColour = vec3(texture(textures, textureCoord));
 	vec3 C = texColour;
 	
-	if (!isStar)
+	if (isStar == 0)
 		C = C * max(0, dot(L, N));
 	
     FragmentColour = vec4(C, 1);
@@ -0,0 +1,71 @@
+// ==========================================================================
+// Fragment program for bodies drawn as impostors, ray casting each sphere
+// for an exact outline, normal, texture coordinate and depth
+// ==========================================================================
+#version 410
+
+// values shared by every draw in a frame, see MyFrameConstants in structs.h
+layout(std140) uniform FrameConstants
+{
+	mat4 projectionMatrix;
+	mat4 viewMatrix;
+	vec4 lightPosition;
+	float time;
+	float viewportHeight;
+	float starMagnitudeLimit;
+	float nearPlane;
+};
+
+uniform sampler2DArray textures;
+
+flat in vec3 sphereCentre;
+flat in float sphereRadius;
+flat in mat3 viewToBody;
+flat in float textureLayer;
+flat in int isStar;
+in vec3 viewPosition;
+
+// first output is mapped to the framebuffer's colour index by default
+out vec4 FragmentColour;
+
+const float PI = 3.1415926535;
+
+void main(void)
+{
+	// nearest point where the ray from the camera meets the sphere, the
+	// centre's distance from the ray taken directly to keep its precision
+	vec3 ray = normalize(viewPosition);
+	float along = dot(ray, sphereCentre);
+	vec3 offset = sphereCentre - along * ray;
+	float halfChordSquared = sphereRadius * sphereRadius - dot(offset, offset);
+	if (halfChordSquared < 0.0)
+		discard;
+	float hit = along - sqrt(halfChordSquared);
+	if (hit <= 0.0)
+		discard;
+
+	vec3 P = hit * ray;
+	vec3 N = (P - sphereCentre) / sphereRadius;
+	gl_FragDepth = nearPlane / -P.z;
+
+	// longitude from the body's z axis towards x, latitude towards y, as
+	// equirectangular textures are laid out with north on the top row
+	vec3 n = viewToBody * N;
+	float u = fract(atan(n.x, n.z) / (2.0 * PI));
+	float v = 0.5 - asin(clamp(n.y, -1.0, 1.0)) / PI;
+
+	// u jumps from 1 to 0 at the seam; measured from the opposite meridian
+	// it does not, and whichever changes less picks the mip level
+	float seamU = fract(u + 0.5) - 0.5;
+	vec2 dx = vec2(abs(dFdx(u)) < abs(dFdx(seamU)) ? dFdx(u) : dFdx(seamU), dFdx(v));
+	vec2 dy = vec2(abs(dFdy(u)) < abs(dFdy(seamU)) ? dFdy(u) : dFdy(seamU), dFdy(v));
+	vec3 C = textureGrad(textures, vec3(u, v, textureLayer), dx, dy).rgb;
+
+	if (isStar == 0)
+	{
+		vec3 L = normalize(lightPosition.xyz - P);
+		C = C * max(0, dot(L, N));
+	}
+
+	FragmentColour = vec4(C, 1);
+}
@@ -0,0 +1,64 @@
+// ==========================================================================
+// Vertex program for bodies drawn as impostors: a square facing the camera
+// per instance, into which the fragment stage ray casts the sphere
+// ==========================================================================
+#version 410
+
+// values shared by every draw in a frame, see MyFrameConstants in structs.h
+layout(std140) uniform FrameConstants
+{
+	mat4 projectionMatrix;
+	mat4 viewMatrix;
+	vec4 lightPosition;
+	float time;
+	float viewportHeight;
+	float starMagnitudeLimit;
+	float nearPlane;
+};
+
+// per-instance records, five texels each: the model matrix columns followed
+// by (texture layer, is star, 0, 0), see MyInstance in structs.h
+uniform samplerBuffer instances;
+uniform int baseInstance;
+
+// the sphere in view space, and the turn from view space into the body's
+// own frame in which its texture is laid out
+flat out vec3 sphereCentre;
+flat out float sphereRadius;
+flat out mat3 viewToBody;
+flat out float textureLayer;
+flat out int isStar;
+
+// point on the square, which the ray to each fragment passes through
+out vec3 viewPosition;
+
+void main()
+{
+	int record = (baseInstance + gl_InstanceID) * 5;
+	mat4 modelMatrix = mat4(texelFetch(instances, record),
+	                        texelFetch(instances, record + 1),
+	                        texelFetch(instances, record + 2),
+	                        texelFetch(instances, record + 3));
+	vec4 parameters = texelFetch(instances, record + 4);
+
+	// bodies are unit spheres scaled evenly, so the scale is any column's length
+	sphereRadius = length(modelMatrix[0].xyz);
+	sphereCentre = vec3(viewMatrix * modelMatrix[3]);
+	viewToBody = transpose(mat3(modelMatrix) / sphereRadius) * transpose(mat3(viewMatrix));
+	textureLayer = parameters.x;
+	isStar = int(parameters.y);
+
+	// the square sits across the sphere's centre, facing the camera, and
+	// is as wide as the cone of sight lines grazing the sphere is there
+	float distance = length(sphereCentre);
+	float halfSize = sphereRadius * distance / sqrt(max(distance * distance - sphereRadius * sphereRadius, 1e-6 * distance * distance));
+	vec3 forward = sphereCentre / distance;
+	vec3 up = abs(forward.y) < 0.99 ? vec3(0, 1, 0) : vec3(1, 0, 0);
+	vec3 right = normalize(cross(up, forward));
+	up = cross(forward, right);
+
+	// a triangle strip of four corners, made up from the vertex index
+	vec2 corner = vec2((gl_VertexID & 1) * 2 - 1, (gl_VertexID & 2) - 1);
+	viewPosition = sphereCentre + halfSize * (corner.x * right + corner.y * up);
+	gl_Position = projectionMatrix * vec4(viewPosition, 1.0);
+}
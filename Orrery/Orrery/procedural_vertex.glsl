@@ -0,0 +1,66 @@
+// ==========================================================================
+// Vertex program for bodies drawn as procedural spheres, whose vertices are
+// made up from gl_VertexID instead of being read from vertex buffers
+// ==========================================================================
+#version 410
+
+// values shared by every draw in a frame, see MyFrameConstants in structs.h
+layout(std140) uniform FrameConstants
+{
+	mat4 projectionMatrix;
+	mat4 viewMatrix;
+	vec4 lightPosition;
+	float time;
+	float viewportHeight;
+	float starMagnitudeLimit;
+	float nearPlane;
+};
+
+// per-instance records, five texels each: the model matrix columns followed
+// by (texture layer, is star, 0, 0), see MyInstance in structs.h
+uniform samplerBuffer instances;
+uniform int baseInstance;
+
+// the sphere's latitude and longitude edge counts, set per draw, which is
+// drawn as latitude * longitude quads of two triangles each
+uniform ivec2 sphereEdges;
+
+// output to be interpolated between vertices and passed to the fragment stage
+out vec3 textureCoord;
+out vec3 vertexNormal;
+out vec3 viewPosition;
+flat out int isStar;
+
+const float PI = 3.1415926535;
+
+// corners of a quad's two triangles as (latitude, longitude) steps from its
+// top left one, wound as InitializeSphere() winds them
+const ivec2 QUAD_CORNERS[6] = ivec2[6](ivec2(1, 0), ivec2(0, 0), ivec2(1, 1),
+                                       ivec2(1, 1), ivec2(0, 0), ivec2(0, 1));
+
+void main()
+{
+	int record = (baseInstance + gl_InstanceID) * 5;
+	mat4 modelMatrix = mat4(texelFetch(instances, record),
+	                        texelFetch(instances, record + 1),
+	                        texelFetch(instances, record + 2),
+	                        texelFetch(instances, record + 3));
+	vec4 parameters = texelFetch(instances, record + 4);
+
+	// rows run from the north pole down, columns from the z axis towards x
+	int quad = gl_VertexID / 6;
+	ivec2 corner = ivec2(quad / sphereEdges.y, quad % sphereEdges.y) + QUAD_CORNERS[gl_VertexID % 6];
+	vec2 coord = vec2(corner.y, corner.x) / vec2(sphereEdges.y, sphereEdges.x);
+	float latitude = PI * (0.5 - coord.y);
+	float longitude = 2.0 * PI * coord.x;
+	vec3 position = vec3(cos(latitude) * sin(longitude), sin(latitude), cos(latitude) * cos(longitude));
+
+	vec4 N = viewMatrix * modelMatrix * vec4(position, 0.0);
+	vec4 P = viewMatrix * modelMatrix * vec4(position, 1.0);
+	gl_Position = projectionMatrix * P;
+
+	textureCoord = vec3(coord, parameters.x);
+	vertexNormal = vec3(N);
+	viewPosition = vec3(P);
+	isStar = int(parameters.y);
+}
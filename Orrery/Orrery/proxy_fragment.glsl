@@ -0,0 +1,9 @@
+// ==========================================================================
+// Fragment program for occlusion query stand-ins, drawn with colour and
+// depth writes off so only the depth test does any work
+// ==========================================================================
+#version 410
+
+void main(void)
+{
+}
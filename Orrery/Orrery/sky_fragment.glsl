@@ -0,0 +1,17 @@
+// ==========================================================================
+// Fragment program for the sky
+// ==========================================================================
+#version 410
+
+// the sky's cube map, on the texture unit every program's textures use
+uniform samplerCube textures;
+
+in vec3 skyDirection;
+
+// first output is mapped to the framebuffer's colour index by default
+out vec4 FragmentColour;
+
+void main(void)
+{
+	FragmentColour = vec4(texture(textures, skyDirection).rgb, 1);
+}
@@ -0,0 +1,34 @@
+// ==========================================================================
+// Vertex program for the sky, one triangle covering the whole screen
+// ==========================================================================
+#version 410
+
+// values shared by every draw in a frame, see MyFrameConstants in structs.h
+layout(std140) uniform FrameConstants
+{
+	mat4 projectionMatrix;
+	mat4 viewMatrix;
+	vec4 lightPosition;
+	float time;
+	float viewportHeight;
+	float starMagnitudeLimit;
+	float nearPlane;
+};
+
+// world space direction the sky is seen in, interpolated across the screen
+out vec3 skyDirection;
+
+void main()
+{
+	// corners at (-1, -1), (3, -1) and (-1, 3) take in the whole screen
+	// with no vertex attributes at all
+	vec2 corner = vec2((gl_VertexID & 1) * 4 - 1, (gl_VertexID & 2) * 2 - 1);
+
+	// the camera only turns the sky, it is infinitely far away
+	vec4 viewRay = inverse(projectionMatrix) * vec4(corner, 1.0, 1.0);
+	skyDirection = transpose(mat3(viewMatrix)) * (viewRay.xyz / viewRay.w);
+
+	// projected as a direction it lands on depth 0, so only pixels no body
+	// covers pass the depth test
+	gl_Position = projectionMatrix * vec4(viewRay.xyz / viewRay.w, 0.0);
+}
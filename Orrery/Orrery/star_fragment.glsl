@@ -0,0 +1,20 @@
+// ==========================================================================
+// Fragment program for the background stars
+// ==========================================================================
+#version 410
+
+in vec3 starColour;
+
+// first output is mapped to the framebuffer's colour index by default
+out vec4 FragmentColour;
+
+void main(void)
+{
+	// a round sprite fading out towards its edge
+	vec2 offset = gl_PointCoord * 2.0 - 1.0;
+	float distanceSquared = dot(offset, offset);
+	if (distanceSquared > 1.0)
+		discard;
+
+	FragmentColour = vec4(starColour * exp(-2.0 * distanceSquared), 1);
+}
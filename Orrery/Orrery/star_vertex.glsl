@@ -0,0 +1,50 @@
+// ==========================================================================
+// Vertex program for the background stars, one point sprite per star
+// ==========================================================================
+#version 410
+
+// values shared by every draw in a frame, see MyFrameConstants in structs.h
+layout(std140) uniform FrameConstants
+{
+	mat4 projectionMatrix;
+	mat4 viewMatrix;
+	vec4 lightPosition;
+	float time;
+	float viewportHeight;
+	float starMagnitudeLimit;
+	float nearPlane;
+};
+
+// location indices for these attributes correspond to those specified in the
+// InitializeStarField() function of the main program, see StarRecord
+layout(location = 0) in vec3 StarDirection;
+layout(location = 1) in float StarMagnitude;
+layout(location = 2) in float StarColourIndex;
+
+out vec3 starColour;
+
+// tints from B - V = -0.4 to 2.0 in steps of 0.4, blue-white to red
+const vec3 STAR_TINTS[7] = vec3[7](vec3(0.62, 0.73, 1.00), vec3(0.80, 0.86, 1.00), vec3(1.00, 0.98, 0.96),
+                                   vec3(1.00, 0.92, 0.80), vec3(1.00, 0.84, 0.64), vec3(1.00, 0.74, 0.48),
+                                   vec3(1.00, 0.64, 0.36));
+
+// sprite diameter in pixels of the faintest star drawn, at 1080 lines
+const float FAINTEST_SIZE = 2.0;
+const float LARGEST_SIZE = 12.0;
+
+void main()
+{
+	// stars are infinitely far away, so the camera only turns them; every
+	// one is projected as a direction, landing on depth 0 behind everything
+	gl_Position = projectionMatrix * vec4(mat3(viewMatrix) * StarDirection, 0.0);
+
+	// light relative to the faintest star drawn: sprites grow with the
+	// fourth root of it and brighten with the square root, so the light
+	// a sprite gives off goes as the star's
+	float flux = pow(10.0, 0.4 * (starMagnitudeLimit - StarMagnitude));
+	gl_PointSize = min(FAINTEST_SIZE * pow(flux, 0.25), LARGEST_SIZE) * viewportHeight / 1080.0;
+
+	float tint = clamp((StarColourIndex + 0.4) / 0.4, 0.0, 6.0);
+	int below = min(int(tint), 5);
+	starColour = mix(STAR_TINTS[below], STAR_TINTS[below + 1], tint - below) * min(0.4 * sqrt(flux), 1.0);
+}
@@ -1,98 +1,178 @@
 #pragma once
+#include "glm/vec2.hpp"
 #include "glm/gtc/matrix_transform.hpp"
+#include "Orbit.h"
+#include "Simulation.h"
+#include "SceneGraph.h"
+#include <math.h>
 
 #define GLFW_INCLUDE_GLCOREARB
 #define GL_GLEXT_PROTOTYPES
 #include "GLFW/glfw3.h"
 
+// OpenGL calls issued by the frame loop, reported in the window title once a second
+extern unsigned int frameGLCalls;
+#define COUNT_GL(call) (frameGLCalls++, call)
+
 struct MyTexture
 {
     // OpenGL names for array buffer objects, vertex array object
     GLuint  textureName;
 
-    // dimensions of the image stored in this texture
+    // dimensions of the images stored in this texture, and how many layers
+    // of them it holds when it is an array texture
     GLuint  width, height;
+    GLuint  layers;
 
     // initialize object names to zero (OpenGL reserved value)
-    MyTexture() : textureName(0), width(0), height(0)
+    MyTexture() : textureName(0), width(0), height(0), layers(0)
     {}
 };
 
 struct MyShader
 {
-    // OpenGL names for vertex and fragment shaders, shader program
+    // OpenGL names for vertex and fragment shaders, the optional
+    // tessellation control and evaluation shaders, shader program
     GLuint  vertex;
     GLuint  fragment;
+    GLuint  control;
+    GLuint  evaluation;
     GLuint  program;
 
+    // uniform locations, resolved once after the program is linked
+    GLint   texturesLocation;
+    GLint   instancesLocation;
+    GLint   baseInstanceLocation;
+    GLint   sphereEdgesLocation;
+
     // initialize shader and program names to zero (OpenGL reserved value)
-    MyShader() : vertex(0), fragment(0), program(0)
+    // and uniform locations to -1 (ignored by glUniform*)
+    MyShader() : vertex(0), fragment(0), control(0), evaluation(0), program(0),
+        texturesLocation(-1), instancesLocation(-1), baseInstanceLocation(-1),
+        sphereEdgesLocation(-1)
     {}
 };
 
+// one interleaved vertex as stored in MyGeometry::vertexBuffer
+struct MyVertex
+{
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 textureCoord;
+};
+
 struct MyGeometry
 {
     // OpenGL names for array buffer objects, vertex array object
     GLuint  vertexBuffer;
-    GLuint	normalBuffer;
-    GLuint  textureCoordBuffer;
+    GLuint  indexBuffer;
     GLuint  vertexArray;
+
+    // layout of the interleaved vertex buffer and the index buffer
+    GLsizei vertexStride;
+    GLsizei vertexCount;
     GLsizei elementCount;
+    GLenum  indexType;
+
+    // initialize object names to zero (OpenGL reserved value)
+    MyGeometry() : vertexBuffer(0), indexBuffer(0), vertexArray(0),
+        vertexStride(0), vertexCount(0), elementCount(0), indexType(GL_UNSIGNED_SHORT)
+    {}
+};
+
+// values shared by every draw in a frame, laid out to match the std140
+// FrameConstants uniform block declared by the shaders
+struct MyFrameConstants
+{
+    glm::mat4 projectionMatrix;
+    glm::mat4 viewMatrix;
+
+    // position of the light (the sun at the origin) in view space
+    glm::vec4 lightPosition;
+
+    // seconds since the program started
+    GLfloat   time;
+
+    // height in pixels of the image being drawn, and the faintest magnitude
+    // of the stars drawn in it
+    GLfloat   viewportHeight;
+    GLfloat   starMagnitudeLimit;
+
+    // distance to the camera's near plane; with its reversed depth and no
+    // far plane, a point's depth is this over its distance in front
+    GLfloat   nearPlane;
+};
+
+// per-body data read by the vertex shader, one record per drawn instance
+struct MyInstance
+{
+    glm::mat4 modelMatrix;
+
+    // x = layer in the body's texture array, y = 1 for self-lit bodies
+    glm::vec4 parameters;
+};
+
+struct MyInstanceBuffer
+{
+    // OpenGL names for the instance data and the buffer texture viewing it
+    GLuint  buffer;
+    GLuint  texture;
+
+    // number of MyInstance records the buffer currently has room for
+    GLsizei capacity;
 
     // initialize object names to zero (OpenGL reserved value)
-    MyGeometry() : vertexBuffer(0), normalBuffer(0), textureCoordBuffer(0), vertexArray(0), elementCount(0)
+    MyInstanceBuffer() : buffer(0), texture(0), capacity(0)
     {}
 };
 
 struct Planet {
 	float radius;
 	
+	// degrees the spin axis leans away from the orbit's normal
+	float axialTilt;
+	
 	MyTexture *texture;
+	int textureLayer;
 	
-	glm::mat4 globalTransform;
+	// path relative to the parent, which the body table evaluates in double
+	// precision before narrowing it for rendering
+	Orbit orbit;
 	
-	glm::mat4 scaleMatrix;
-	glm::mat4 translationMatrix;
-	glm::mat4 axialTiltMatrix;
-	glm::mat4 localRotationMatrix;
-	glm::mat4 orbitalRotationMatrix;
+	// length of a day in simulated seconds, 0 for a body that does not spin
+	double localPeriod;
 	
-	float localAccRotDeg;
-	float orbitalAccRotDeg;
-	float localRotPerSec;
-	float orbitalRotPerSec;
+	// row of this body in the scene's BodyTable, and the scene graph node
+	// that holds its transforms
+	size_t bodyIndex;
+	int sceneNode;
 	
-	Planet(float radius, float distance, float localPeriod, float orbitalPeriod, float axialTilt, MyTexture *texture)
+	// index into the sphere level of detail chain, chosen every frame
+	int lod;
+	
+	Planet(float radius, const OrbitalElements &orbit, float localPeriod, float axialTilt, MyTexture *texture, int textureLayer)
 	{
 		this->radius = radius;
-		
-		if (localPeriod > 0)
-			this->localRotPerSec = (float)(2 * 3.1415926535) /(localPeriod*3600.0f);
-		else
-			this->localRotPerSec = 0;
-		
-		if (orbitalPeriod)
-			this->orbitalRotPerSec = (float)(2 * 3.1415926535) /(orbitalPeriod*3600.0f);
-		else
-			this->orbitalRotPerSec = 0;
-			
-		this->localAccRotDeg = 0.0f;
-		this->orbitalAccRotDeg = 0.0f;
+		this->axialTilt = axialTilt;
+		this->orbit = Orbit(orbit);
+		this->localPeriod = localPeriod * 3600.0;
 		this->texture = texture;
-
-		this->scaleMatrix = glm::scale(glm::mat4(), glm::vec3(radius, radius, radius));
-		this->translationMatrix = glm::translate(glm::mat4(), glm::vec3(distance,0,0));
-		this->axialTiltMatrix = glm::rotate(glm::mat4(), (float)(axialTilt * 3.1415926535) / 180.0f, glm::vec3(0,0,1));
+		this->textureLayer = textureLayer;
+		this->lod = 0;
+		this->bodyIndex = 0;
+		this->sceneNode = -1;
+	}
+	
+	// gives the body a node in the scene graph under its parent's, or at the
+	// root for a null parent, which must already have been added
+	void AddToScene(SceneGraph *scene, const Planet *parent)
+	{
+		this->sceneNode = scene->AddNode(parent ? parent->sceneNode : -1, this->radius, glm::radians(this->axialTilt));
 	}
 	
-	void Update(float deltaTime)
+	// moves the body's node to where a simulation snapshot has it
+	void Update(const SimulationSnapshot &state, SceneGraph *scene)
 	{
-		this->localAccRotDeg += this->localRotPerSec * deltaTime;
-		this->orbitalAccRotDeg += this->orbitalRotPerSec * deltaTime;
-		
-		this->localRotationMatrix = glm::rotate(glm::mat4(), this->localAccRotDeg, glm::vec3(0,1,0));
-		this->orbitalRotationMatrix = glm::rotate(glm::mat4(), this->orbitalAccRotDeg, glm::vec3(0,1,0));
-		
-		this->globalTransform = this->orbitalRotationMatrix * this->translationMatrix;
+		scene->SetLocal(this->sceneNode, state.bodyPositions[this->bodyIndex], state.spinAngles[this->bodyIndex]);
 	}
 };
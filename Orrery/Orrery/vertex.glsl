@@ -6,31 +6,51 @@
 // ==========================================================================
 #version 410
 
-// location indices for these attributes correspond to those specified in the
-// InitializeGeometry() function of the main program
-uniform sampler2DRect texture;
-uniform mat4 projectionMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 modelMatrix;
+// values shared by every draw in a frame, see MyFrameConstants in structs.h
+layout(std140) uniform FrameConstants
+{
+	mat4 projectionMatrix;
+	mat4 viewMatrix;
+	vec4 lightPosition;
+	float time;
+	float viewportHeight;
+	float starMagnitudeLimit;
+	float nearPlane;
+};
+
+// per-instance records, five texels each: the model matrix columns followed
+// by (texture layer, is star, 0, 0), see MyInstance in structs.h
+uniform samplerBuffer instances;
+uniform int baseInstance;
 
+// location indices for these attributes correspond to those specified in the
+// InitializeSphere() function of the main program
 layout(location = 0) in vec3 VertexPosition;
 layout(location = 1) in vec2 textureCoordData;
 layout(location = 2) in vec3 VertexNormal;
 
 // output to be interpolated between vertices and passed to the fragment stage
-out vec2 textureCoord;
+out vec3 textureCoord;
 out vec3 vertexNormal;
-out vec3 lightVector;
+out vec3 viewPosition;
+flat out int isStar;
 
 void main()
 {
-	vec4 L = viewMatrix * vec4(0 , 0 , 0 , 1.0);
+	int record = (baseInstance + gl_InstanceID) * 5;
+	mat4 modelMatrix = mat4(texelFetch(instances, record),
+	                        texelFetch(instances, record + 1),
+	                        texelFetch(instances, record + 2),
+	                        texelFetch(instances, record + 3));
+	vec4 parameters = texelFetch(instances, record + 4);
+
 	vec4 N = viewMatrix * modelMatrix * vec4(VertexNormal, 0.0);
 	vec4 P = viewMatrix * modelMatrix * vec4(VertexPosition, 1.0);
     gl_Position =  projectionMatrix * P;
 
     // assign output colour to be interpolated
-    textureCoord = textureCoordData;
+    textureCoord = vec3(textureCoordData, parameters.x);
     vertexNormal = vec3(N);
-    lightVector = vec3(L - P);
+    viewPosition = vec3(P);
+    isStar = int(parameters.y);
 }